@@ -0,0 +1,550 @@
+#ifndef BITMAP_SET_H
+#define BITMAP_SET_H
+
+#include <vector>
+#include <iostream>
+#include <utility>
+#include <algorithm>
+#include <iterator>
+#include <cstdint>
+#include <type_traits>
+#include <thread>
+
+#include "parallel_sort.h"
+
+using namespace std;
+
+/*
+* Set of integers stored as a compressed bitmap, in the style of Roaring bitmaps.
+* Same interface as Set<T>, for integral T of at most 32 bits.
+*
+* The 32-bit key space is cut in chunks of 2^16 values, one per value of the high 16 bits.
+* Each non-empty chunk stores its low 16 bits in the smallest of three containers:
+*   ARRAY  - sorted values, 2 bytes per element, only for chunks of up to 4096 elements
+*   BITMAP - 2^16 bits, 8 KB
+*   RUN    - sorted runs of consecutive values, 4 bytes per run
+* Union, intersection and difference of two chunks are word-parallel bitwise operations on
+* bitmaps, except when an array is involved and looking its values up is cheaper.
+* Results are always stored in the smallest container, so equal sets are stored the same way.
+*/
+template <class T>
+class BitmapSet{
+    static_assert(is_integral<T>::value && sizeof(T) <= 4, "BitmapSet holds integers of at most 32 bits");
+
+public:
+    // Constructors
+    BitmapSet();                        // Default
+    BitmapSet(const T& v);              // Type conversion
+    BitmapSet(const BitmapSet& R);      // Copy
+    BitmapSet(BitmapSet&& S) noexcept;  // Move
+    BitmapSet(T a[], int n);            // Conversion from sorted array
+
+    // Conversion from any range, unsorted and with duplicates
+    template <class It, class = typename iterator_traits<It>::iterator_category>
+    BitmapSet(It first, It last, unsigned threads = thread::hardware_concurrency());
+
+    template <class Range>
+    static BitmapSet from_range(const Range& r, unsigned threads = thread::hardware_concurrency()) {
+        return BitmapSet(std::begin(r), std::end(r), threads);
+    }
+
+    // Member functions
+    int cardinality() const;
+    bool is_member(const T & v) const;
+    void make_empty();
+    bool _empty() const;
+
+    // Operators
+    const BitmapSet& operator=(BitmapSet S);              // Assignment
+    const BitmapSet& operator+=(const BitmapSet & S);     // Union
+    const BitmapSet& operator*=(const BitmapSet & S);     // Intersection
+    const BitmapSet& operator-=(const BitmapSet & S);     // Difference
+
+    friend BitmapSet operator+(const BitmapSet& L, const BitmapSet& R) {
+        BitmapSet<T> ret(L);
+        return ret += R;
+    };
+
+    friend BitmapSet operator*(const BitmapSet& L, const BitmapSet& R) {
+        BitmapSet<T> ret(L);
+        return ret *= R;
+    };
+
+    friend BitmapSet operator-(const BitmapSet& L, const BitmapSet& R) {
+        BitmapSet<T> ret(L);
+        return ret -= R;
+    };
+
+    bool operator<=(const BitmapSet& S) const;
+    bool operator<(const BitmapSet& S) const;
+    bool operator==(const BitmapSet& S) const;
+    bool operator!=(const BitmapSet& S) const;
+
+    // Formatted output operator<<
+    friend ostream& operator<<(ostream& os, const BitmapSet<T> & S){
+        os << "{ ";
+        for (const Chunk& c : S.chunks) {
+            for_each_low(c, [&](uint16_t low) {
+                os << value_of(((uint32_t)c.key << 16) | low) << " ";
+            });
+        }
+        os << "}";
+        return os;
+    }
+
+private:
+    enum Kind { ARRAY, BITMAP, RUN };
+
+    static constexpr int WORDS = (1 << 16) / 64;  // words in a bitmap container
+    static constexpr int MAX_ARRAY = 4096;        // largest array container
+
+    class Chunk {
+    public:
+        uint16_t key = 0;           // high 16 bits of the values in the chunk
+        Kind kind = ARRAY;
+        int card = 0;               // number of values in the chunk
+
+        vector<uint16_t> array;                   // ARRAY: sorted low bits
+        vector<uint64_t> bits;                    // BITMAP: WORDS words
+        vector<pair<uint16_t, uint16_t>> runs;    // RUN: first and last value of each run
+
+        bool operator==(const Chunk& c) const {
+            return key == c.key && kind == c.kind && array == c.array && bits == c.bits && runs == c.runs;
+        }
+    };
+
+    // Values are mapped to unsigned 32-bit keys in the same order, signed values are biased
+    static uint32_t key_of(T v) {
+        if constexpr (is_signed<T>::value) return (uint32_t)(int32_t)v ^ 0x80000000u;
+        else return (uint32_t)v;
+    }
+
+    static T value_of(uint32_t k) {
+        if constexpr (is_signed<T>::value) return (T)(int32_t)(k ^ 0x80000000u);
+        else return (T)k;
+    }
+
+    // Container helpers
+    static bool contains(const Chunk& c, uint16_t low);
+    template <class F>
+    static void for_each_low(const Chunk& c, F f);
+    static vector<uint64_t> to_bits(const Chunk& c);
+    static void store_bits(Chunk& c, vector<uint64_t>& bits);
+    static void store_array(Chunk& c, vector<uint16_t>& values);
+
+    static void unite(Chunk& c, const Chunk& d);
+    static void intersect(Chunk& c, const Chunk& d);
+    static void subtract(Chunk& c, const Chunk& d);
+
+    // Builds the chunks from sorted, unique values
+    template <class It>
+    void build(It first, It last);
+
+    const Chunk* find(uint16_t key) const;
+
+    // Non-empty chunks, sorted by key
+    vector<Chunk> chunks;
+};
+
+/*
+ * Constructors
+ */
+template <class T>
+BitmapSet<T>::BitmapSet() {}
+
+template <class T>
+BitmapSet<T>::BitmapSet(const T& v) {
+    build(&v, &v + 1);
+}
+
+template <class T>
+BitmapSet<T>::BitmapSet(const BitmapSet& R) : chunks(R.chunks) {}
+
+template <class T>
+BitmapSet<T>::BitmapSet(BitmapSet&& S) noexcept : chunks(std::move(S.chunks)) {}
+
+template <class T>
+BitmapSet<T>::BitmapSet(T a[], int n) {
+    build(a, a + n);
+}
+
+template <class T>
+template <class It, class>
+BitmapSet<T>::BitmapSet(It first, It last, unsigned threads) {
+    vector<T> v(first, last);
+    parallel_sort_unique(v, threads);
+    build(v.begin(), v.end());
+}
+
+/*
+* Puclic member functions
+*/
+template <class T>
+int BitmapSet<T>::cardinality() const {
+    int n = 0;
+    for (const Chunk& c : chunks) n += c.card;
+    return n;
+}
+
+template <class T>
+bool BitmapSet<T>::is_member(const T & v) const {
+    uint32_t k = key_of(v);
+    const Chunk* c = find((uint16_t)(k >> 16));
+    return c && contains(*c, (uint16_t)k);
+}
+
+template <class T>
+void BitmapSet<T>::make_empty() {
+    chunks.clear();
+}
+
+template <class T>
+bool BitmapSet<T>::_empty() const {
+    return chunks.empty();
+}
+
+/*
+* Private member functions
+*/
+template <class T>
+template <class It>
+void BitmapSet<T>::build(It first, It last) {
+    vector<uint16_t> low;
+    while (first != last) {
+        uint16_t key = (uint16_t)(key_of(*first) >> 16);
+        low.clear();
+        while (first != last && (uint16_t)(key_of(*first) >> 16) == key) {
+            low.push_back((uint16_t)key_of(*first));
+            ++first;
+        }
+        chunks.emplace_back();
+        chunks.back().key = key;
+        store_array(chunks.back(), low);
+    }
+}
+
+// Chunk with the given key, or nullptr
+template <class T>
+const typename BitmapSet<T>::Chunk* BitmapSet<T>::find(uint16_t key) const {
+    auto it = lower_bound(chunks.begin(), chunks.end(), key,
+                          [](const Chunk& c, uint16_t k) { return c.key < k; });
+    return (it != chunks.end() && it->key == key) ? &*it : nullptr;
+}
+
+template <class T>
+bool BitmapSet<T>::contains(const Chunk& c, uint16_t low) {
+    switch (c.kind) {
+    case ARRAY:
+        return binary_search(c.array.begin(), c.array.end(), low);
+    case BITMAP:
+        return (c.bits[low >> 6] >> (low & 63)) & 1;
+    default: {
+        // Last run that starts at or before low
+        auto it = upper_bound(c.runs.begin(), c.runs.end(), low,
+                              [](uint16_t v, const pair<uint16_t, uint16_t>& r) { return v < r.first; });
+        return it != c.runs.begin() && low <= (it - 1)->second;
+    }
+    }
+}
+
+// Calls f with every value of c, in increasing order
+template <class T>
+template <class F>
+void BitmapSet<T>::for_each_low(const Chunk& c, F f) {
+    switch (c.kind) {
+    case ARRAY:
+        for (uint16_t v : c.array) f(v);
+        break;
+    case BITMAP:
+        for (int w = 0; w < WORDS; ++w) {
+            for (uint64_t word = c.bits[w]; word; word &= word - 1) {
+                f((uint16_t)(w * 64 + __builtin_ctzll(word)));
+            }
+        }
+        break;
+    default:
+        for (const auto& r : c.runs) {
+            for (uint32_t v = r.first; v <= r.second; ++v) f((uint16_t)v);
+        }
+    }
+}
+
+template <class T>
+vector<uint64_t> BitmapSet<T>::to_bits(const Chunk& c) {
+    if (c.kind == BITMAP) return c.bits;
+
+    vector<uint64_t> bits(WORDS, 0);
+    if (c.kind == ARRAY) {
+        for (uint16_t v : c.array) bits[v >> 6] |= 1ull << (v & 63);
+        return bits;
+    }
+
+    // Fill whole words inside a run, and masks at its ends
+    for (const auto& r : c.runs) {
+        int first = r.first, last = r.second;
+        int fw = first >> 6, lw = last >> 6;
+        uint64_t fmask = ~0ull << (first & 63);
+        uint64_t lmask = ~0ull >> (63 - (last & 63));
+        if (fw == lw) {
+            bits[fw] |= fmask & lmask;
+        } else {
+            bits[fw] |= fmask;
+            for (int w = fw + 1; w < lw; ++w) bits[w] = ~0ull;
+            bits[lw] |= lmask;
+        }
+    }
+    return bits;
+}
+
+// Stores the values of a bitmap in c, in the smallest container
+template <class T>
+void BitmapSet<T>::store_bits(Chunk& c, vector<uint64_t>& bits) {
+    // A run starts at every set bit whose lower neighbour is clear
+    int card = 0, nruns = 0;
+    uint64_t carry = 0;
+    for (int w = 0; w < WORDS; ++w) {
+        card += __builtin_popcountll(bits[w]);
+        nruns += __builtin_popcountll(bits[w] & ~((bits[w] << 1) | carry));
+        carry = bits[w] >> 63;
+    }
+
+    c.card = card;
+    c.array.clear();
+    c.runs.clear();
+
+    size_t array_bytes = (card <= MAX_ARRAY) ? 2 * (size_t)card : SIZE_MAX;
+    size_t run_bytes = 4 * (size_t)nruns;
+    size_t bitmap_bytes = 8 * (size_t)WORDS;
+
+    if (array_bytes <= run_bytes && array_bytes <= bitmap_bytes) {
+        c.kind = ARRAY;
+        c.array.reserve(card);
+        for (int w = 0; w < WORDS; ++w) {
+            for (uint64_t word = bits[w]; word; word &= word - 1) {
+                c.array.push_back((uint16_t)(w * 64 + __builtin_ctzll(word)));
+            }
+        }
+        c.bits.clear();
+    } else if (run_bytes < bitmap_bytes) {
+        c.kind = RUN;
+        c.runs.reserve(nruns);
+        // Runs of set bits, found a word at a time
+        int v = 0;
+        while (v < (1 << 16)) {
+            int w = v >> 6;
+            uint64_t word = bits[w] & (~0ull << (v & 63));
+            while (!word && ++w < WORDS) word = bits[w];
+            if (w == WORDS) break;
+            int first = w * 64 + __builtin_ctzll(word);
+
+            word = ~bits[w] & (~0ull << (first & 63));
+            while (!word && ++w < WORDS) word = ~bits[w];
+            int end = (w == WORDS) ? (1 << 16) : w * 64 + __builtin_ctzll(word);
+
+            c.runs.emplace_back((uint16_t)first, (uint16_t)(end - 1));
+            v = end;
+        }
+        c.bits.clear();
+    } else {
+        c.kind = BITMAP;
+        c.bits.swap(bits);
+    }
+}
+
+// Stores sorted values in c, in the smallest container
+template <class T>
+void BitmapSet<T>::store_array(Chunk& c, vector<uint16_t>& values) {
+    int card = (int)values.size();
+    int nruns = 0;
+    for (int i = 0; i < card; ++i) {
+        if (i == 0 || values[i] != values[i - 1] + 1) nruns++;
+    }
+
+    if (card <= MAX_ARRAY && 2 * card <= 4 * nruns) {
+        c.kind = ARRAY;
+        c.card = card;
+        c.array = values;
+        c.bits.clear();
+        c.runs.clear();
+        return;
+    }
+
+    Chunk tmp;
+    tmp.kind = ARRAY;
+    tmp.array.swap(values);
+    vector<uint64_t> bits = to_bits(tmp);
+    tmp.array.swap(values);
+    store_bits(c, bits);
+}
+
+template <class T>
+void BitmapSet<T>::unite(Chunk& c, const Chunk& d) {
+    if (c.kind == ARRAY && d.kind == ARRAY && c.card + d.card <= MAX_ARRAY) {
+        vector<uint16_t> values;
+        values.reserve(c.card + d.card);
+        set_union(c.array.begin(), c.array.end(), d.array.begin(), d.array.end(), back_inserter(values));
+        store_array(c, values);
+        return;
+    }
+
+    vector<uint64_t> bits = to_bits(c);
+    if (d.kind == BITMAP) {
+        for (int w = 0; w < WORDS; ++w) bits[w] |= d.bits[w];
+    } else {
+        vector<uint64_t> other = to_bits(d);
+        for (int w = 0; w < WORDS; ++w) bits[w] |= other[w];
+    }
+    store_bits(c, bits);
+}
+
+template <class T>
+void BitmapSet<T>::intersect(Chunk& c, const Chunk& d) {
+    // Looking up the elements of an array is cheaper than building bitmaps
+    if (c.kind == ARRAY || d.kind == ARRAY) {
+        const Chunk& small = (c.kind == ARRAY) ? c : d;
+        const Chunk& other = (c.kind == ARRAY) ? d : c;
+        vector<uint16_t> values;
+        for (uint16_t v : small.array) {
+            if (contains(other, v)) values.push_back(v);
+        }
+        store_array(c, values);
+        return;
+    }
+
+    vector<uint64_t> bits = to_bits(c);
+    vector<uint64_t> other = to_bits(d);
+    for (int w = 0; w < WORDS; ++w) bits[w] &= other[w];
+    store_bits(c, bits);
+}
+
+template <class T>
+void BitmapSet<T>::subtract(Chunk& c, const Chunk& d) {
+    if (c.kind == ARRAY) {
+        vector<uint16_t> values;
+        for (uint16_t v : c.array) {
+            if (!contains(d, v)) values.push_back(v);
+        }
+        store_array(c, values);
+        return;
+    }
+
+    vector<uint64_t> bits = to_bits(c);
+    vector<uint64_t> other = to_bits(d);
+    for (int w = 0; w < WORDS; ++w) bits[w] &= ~other[w];
+    store_bits(c, bits);
+}
+
+/*
+* Operators
+*/
+template <class T>
+const BitmapSet<T>& BitmapSet<T>::operator=(BitmapSet S) {
+    std::swap(chunks, S.chunks);
+    return *this;
+}
+
+template <class T>
+const BitmapSet<T>& BitmapSet<T>::operator+=(const BitmapSet & S) {
+    if (&S == this) return *this;
+
+    // Merge the chunk lists by key, chunks with the same key are united
+    vector<Chunk> ret;
+    ret.reserve(chunks.size() + S.chunks.size());
+    size_t i = 0, j = 0;
+    while (i < chunks.size() || j < S.chunks.size()) {
+        if (j == S.chunks.size() || (i < chunks.size() && chunks[i].key < S.chunks[j].key)) {
+            ret.push_back(std::move(chunks[i++]));
+        } else if (i == chunks.size() || S.chunks[j].key < chunks[i].key) {
+            ret.push_back(S.chunks[j++]);
+        } else {
+            unite(chunks[i], S.chunks[j++]);
+            ret.push_back(std::move(chunks[i++]));
+        }
+    }
+    std::swap(chunks, ret);
+    return *this;
+}
+
+template <class T>
+const BitmapSet<T>& BitmapSet<T>::operator*=(const BitmapSet & S) {
+    if (&S == this) return *this;
+
+    // Only keys in both sets are kept, and only if the intersection is not empty
+    size_t w = 0, i = 0, j = 0;
+    while (i < chunks.size() && j < S.chunks.size()) {
+        if (chunks[i].key < S.chunks[j].key) {
+            i++;
+        } else if (S.chunks[j].key < chunks[i].key) {
+            j++;
+        } else {
+            intersect(chunks[i], S.chunks[j++]);
+            if (chunks[i].card > 0) {
+                if (w != i) chunks[w] = std::move(chunks[i]);
+                w++;
+            }
+            i++;
+        }
+    }
+    chunks.erase(chunks.begin() + w, chunks.end());
+    return *this;
+}
+
+template <class T>
+const BitmapSet<T>& BitmapSet<T>::operator-=(const BitmapSet & S) {
+    if (&S == this) {
+        chunks.clear();
+        return *this;
+    }
+
+    size_t w = 0, j = 0;
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        while (j < S.chunks.size() && S.chunks[j].key < chunks[i].key) j++;
+        if (j < S.chunks.size() && S.chunks[j].key == chunks[i].key) {
+            subtract(chunks[i], S.chunks[j]);
+        }
+        if (chunks[i].card > 0) {
+            if (w != i) chunks[w] = std::move(chunks[i]);
+            w++;
+        }
+    }
+    chunks.erase(chunks.begin() + w, chunks.end());
+    return *this;
+}
+
+template <class T>
+bool BitmapSet<T>::operator<=(const BitmapSet& S) const {
+    for (const Chunk& c : chunks) {
+        const Chunk* d = S.find(c.key);
+        if (!d || c.card > d->card) return false;
+
+        if (c.kind == ARRAY) {
+            for (uint16_t v : c.array) {
+                if (!contains(*d, v)) return false;
+            }
+        } else {
+            vector<uint64_t> bits = to_bits(c);
+            vector<uint64_t> other = to_bits(*d);
+            for (int w = 0; w < WORDS; ++w) {
+                if (bits[w] & ~other[w]) return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <class T>
+bool BitmapSet<T>::operator<(const BitmapSet& S) const {
+    return cardinality() < S.cardinality() && *this <= S;
+}
+
+// Every chunk is stored in its smallest container, equal sets have equal chunks
+template <class T>
+bool BitmapSet<T>::operator==(const BitmapSet& S) const {
+    return chunks == S.chunks;
+}
+
+template <class T>
+bool BitmapSet<T>::operator!=(const BitmapSet& S) const {
+    return !(*this == S);
+}
+#endif // BITMAP_SET_H
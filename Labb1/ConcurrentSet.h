@@ -0,0 +1,149 @@
+#ifndef CONCURRENT_SET_H
+#define CONCURRENT_SET_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <iostream>
+
+#include "Set.h"
+
+using namespace std;
+
+/*
+* Set that many threads can insert into, remove from and look up in at the same time.
+*
+* The elements are spread over shards by their hash, each shard is a Set with its own
+* mutex and a skip-list index. Threads that work on different shards do not wait for
+* each other, so with a few shards per thread contention stays low.
+*
+* snapshot() returns the elements as a plain Set, for the set operators. It holds every
+* shard lock at once, so it sees the set as it was at one moment. The shards are only
+* copied while the locks are held, each copy is O(1) and shares the nodes and the index
+* of its shard, and they are merged after the locks are released.
+*/
+template <class T>
+class ConcurrentSet{
+public:
+    // Constructors
+    ConcurrentSet(unsigned shards = 4 * max(thread::hardware_concurrency(), 1u));
+    ConcurrentSet(const ConcurrentSet& R) = delete;
+
+    // Member functions, each one is atomic
+    bool insert(const T& v);        // True when v was not in the set before
+    bool remove(const T& v);        // True when v was in the set
+    bool is_member(const T & v) const;
+    int cardinality() const;
+
+    // All elements, at one moment
+    Set<T> snapshot() const;
+
+    // Formatted output operator<<, prints a snapshot
+    friend ostream& operator<<(ostream& os, const ConcurrentSet<T> & S){
+        return os << S.snapshot();
+    }
+
+private:
+    class Shard {
+    public:
+        mutable mutex lock;
+        Set<T> set;
+    };
+
+    Shard& shard_of(const T& v) const {
+        return *shards[hash<T>()(v) % shards.size()];
+    }
+
+    // Locks every shard, always in the same order
+    vector<unique_lock<mutex>> lock_all() const;
+
+    // Shards can not be moved, they hold a mutex
+    vector<unique_ptr<Shard>> shards;
+};
+
+/*
+ * Constructors
+ */
+template <class T>
+ConcurrentSet<T>::ConcurrentSet(unsigned shards) {
+    for (unsigned i = 0; i < max(shards, 1u); ++i) {
+        this->shards.emplace_back(new Shard);
+        this->shards.back()->set.use_index();
+    }
+}
+
+/*
+* Puclic member functions
+*/
+template <class T>
+bool ConcurrentSet<T>::insert(const T& v) {
+    Shard& s = shard_of(v);
+    lock_guard<mutex> guard(s.lock);
+
+    int n = s.set.cardinality();
+    s.set.insert(v);
+    return s.set.cardinality() > n;
+}
+
+template <class T>
+bool ConcurrentSet<T>::remove(const T& v) {
+    Shard& s = shard_of(v);
+    lock_guard<mutex> guard(s.lock);
+
+    int n = s.set.cardinality();
+    s.set.remove(v);
+    return s.set.cardinality() < n;
+}
+
+// The shard lock is needed for lookups too, an insert or remove on another thread
+// changes the chain and the index of the shard
+template <class T>
+bool ConcurrentSet<T>::is_member(const T & v) const {
+    Shard& s = shard_of(v);
+    lock_guard<mutex> guard(s.lock);
+
+    return s.set.is_member(v);
+}
+
+template <class T>
+int ConcurrentSet<T>::cardinality() const {
+    vector<unique_lock<mutex>> locks = lock_all();
+
+    int n = 0;
+    for (const auto& s : shards) n += s->set.cardinality();
+    return n;
+}
+
+template <class T>
+Set<T> ConcurrentSet<T>::snapshot() const {
+    vector<Set<T>> parts;
+    parts.reserve(shards.size());
+    {
+        vector<unique_lock<mutex>> locks = lock_all();
+        for (const auto& s : shards) parts.push_back(s->set);
+    }
+    Set<T> ret = Set<T>::union_all(parts);
+
+    // Each copy is dropped under its shard lock, so the next change of the shard
+    // comes after the merge has read the shared nodes
+    for (size_t i = 0; i < shards.size(); ++i) {
+        lock_guard<mutex> guard(shards[i]->lock);
+        parts[i].make_empty();
+    }
+    return ret;
+}
+
+/*
+* Private member functions
+*/
+template <class T>
+vector<unique_lock<mutex>> ConcurrentSet<T>::lock_all() const {
+    vector<unique_lock<mutex>> locks;
+    locks.reserve(shards.size());
+    for (const auto& s : shards) locks.emplace_back(s->lock);
+    return locks;
+}
+
+#endif // CONCURRENT_SET_H
@@ -0,0 +1,472 @@
+#ifndef FLAT_SET_H
+#define FLAT_SET_H
+
+#include <vector>
+#include <iostream>
+#include <utility>
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+#include <thread>
+
+#include "simd_merge.h"
+#include "parallel_sort.h"
+
+using namespace std;
+
+/*
+* Set of sorted, unique elements stored in one contiguous buffer.
+* Same interface as Set<T>, but union, intersection and difference
+* are linear merges over flat arrays instead of walks through a node chain.
+*/
+template <class T>
+class FlatSet{
+public:
+    // Constructors
+    FlatSet();                      // Default
+    FlatSet(const T& v);            // Type conversion
+    FlatSet(const FlatSet& R);      // Copy
+    FlatSet(FlatSet&& S) noexcept;  // Move
+    FlatSet(T a[], int n);          // Conversion from sorted array
+
+    // Conversion from any range, unsorted and with duplicates. Sorted in parallel
+    template <class It, class = typename iterator_traits<It>::iterator_category>
+    FlatSet(It first, It last, unsigned threads = thread::hardware_concurrency());
+
+    template <class Range>
+    static FlatSet from_range(const Range& r, unsigned threads = thread::hardware_concurrency()) {
+        return FlatSet(std::begin(r), std::end(r), threads);
+    }
+
+    // Member functions
+    int cardinality() const;
+    bool is_member(const T & v) const;
+    void make_empty();
+    bool _empty() const;
+
+    // Operators
+    const FlatSet& operator=(FlatSet S);              // Assignment
+    const FlatSet& operator+=(const FlatSet & S);     // Union
+    const FlatSet& operator*=(const FlatSet & S);     // Intersection
+    const FlatSet& operator-=(const FlatSet & S);     // Difference
+
+    friend FlatSet operator+(const FlatSet& L, const FlatSet& R) {
+        FlatSet<T> ret(L);
+        return ret += R;
+    };
+
+    friend FlatSet operator*(const FlatSet& L, const FlatSet& R) {
+        FlatSet<T> ret(L);
+        return ret *= R;
+    };
+
+    friend FlatSet operator-(const FlatSet& L, const FlatSet& R) {
+        FlatSet<T> ret(L);
+        return ret -= R;
+    };
+
+    bool operator<=(const FlatSet& S) const;
+    bool operator<(const FlatSet& S) const;
+    bool operator==(const FlatSet& S) const;
+    bool operator!=(const FlatSet& S) const;
+
+    // Union and intersection of operands with at least parallel_threshold elements
+    // in total are split in key ranges that are merged on parallel_threads threads
+    static size_t parallel_threshold;
+    static unsigned parallel_threads;
+
+    // Formatted output operator<<
+    friend ostream& operator<<(ostream& os, const FlatSet<T> & S){
+        os << "{ ";
+        for (const T& v : S.data) {
+            os << v << " ";
+        }
+        os << "}";
+        return os;
+    }
+
+private:
+    // Operands whose sizes differ more than this factor are merged by galloping
+    static constexpr size_t GALLOP_RATIO = 32;
+
+    static bool skewed(size_t m, size_t n) {
+        return m * GALLOP_RATIO < n;
+    }
+
+    static size_t gallop(const vector<T>& v, size_t lo, const T& x);
+
+    // 32-bit integers use the vector kernels in simd_merge.h
+    static constexpr bool use_simd = is_integral<T>::value && sizeof(T) == 4;
+
+    // In place intersection of a[0, na) with b[0, nb), returns the new size of a
+    static size_t intersect(T* a, size_t na, const T* b, size_t nb);
+
+    bool use_threads(const FlatSet& S) const {
+        return parallel_threads > 1 && !data.empty() && !S.data.empty() &&
+               data.size() + S.data.size() >= parallel_threshold;
+    }
+
+    void partition(const FlatSet& S, vector<size_t>& cuts, vector<size_t>& cutsS) const;
+    void parallel_union(const FlatSet& S);
+    void parallel_intersection(const FlatSet& S);
+
+    // Sorted, without duplicates
+    vector<T> data;
+};
+
+template <class T>
+size_t FlatSet<T>::parallel_threshold = 1 << 20;
+
+template <class T>
+unsigned FlatSet<T>::parallel_threads = thread::hardware_concurrency();
+
+/*
+ * Constructors
+ */
+template <class T>
+FlatSet<T>::FlatSet() {}
+
+template <class T>
+FlatSet<T>::FlatSet(const T& v) : data(1, v) {}
+
+template <class T>
+FlatSet<T>::FlatSet(const FlatSet& R) : data(R.data) {}
+
+template <class T>
+FlatSet<T>::FlatSet(FlatSet&& S) noexcept : data(std::move(S.data)) {}
+
+template <class T>
+FlatSet<T>::FlatSet(T a[], int n) : data(a, a + n) {}
+
+template <class T>
+template <class It, class>
+FlatSet<T>::FlatSet(It first, It last, unsigned threads) : data(first, last) {
+    parallel_sort_unique(data, threads);
+}
+
+
+/*
+* Puclic member functions
+*/
+template <class T>
+int FlatSet<T>::cardinality() const {
+    return (int)data.size();
+}
+
+template <class T>
+bool FlatSet<T>::is_member(const T & v) const {
+    return binary_search(data.begin(), data.end(), v);
+}
+
+template <class T>
+void FlatSet<T>::make_empty() {
+    data.clear();
+}
+
+template <class T>
+bool FlatSet<T>::_empty() const {
+    return data.empty();
+}
+
+/*
+* Private member functions
+*/
+
+// Index of the first element in v[lo..] that is not less than x.
+// The step from lo doubles until x is passed, then the last step is binary searched,
+// so the cost is logarithmic in the distance moved and not in the size of v
+template <class T>
+size_t FlatSet<T>::gallop(const vector<T>& v, size_t lo, const T& x) {
+    size_t hi = lo, step = 1;
+    while (hi < v.size() && v[hi] < x) {
+        lo = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    hi = min(hi, v.size());
+    return lower_bound(v.begin() + lo, v.begin() + hi, x) - v.begin();
+}
+
+template <class T>
+size_t FlatSet<T>::intersect(T* a, size_t na, const T* b, size_t nb) {
+    if constexpr (use_simd) {
+        return intersect_sorted(a, na, b, nb, a);
+    }
+
+    // Kept elements are compacted towards the front, w never passes i
+    size_t w = 0, i = 0, j = 0;
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (b[j] < a[i]) {
+            j++;
+        } else {
+            if (w != i) a[w] = std::move(a[i]);
+            w++; i++; j++;
+        }
+    }
+    return w;
+}
+
+// Cuts this set and S at the same keys, part k is data[cuts[k], cuts[k+1]) and
+// S.data[cutsS[k], cutsS[k+1]). The keys are evenly spaced elements of the larger set
+template <class T>
+void FlatSet<T>::partition(const FlatSet& S, vector<size_t>& cuts, vector<size_t>& cutsS) const {
+    const vector<T>& large = (data.size() < S.data.size()) ? S.data : data;
+    size_t parts = parallel_threads;
+
+    cuts.assign(1, 0);
+    cutsS.assign(1, 0);
+    for (size_t k = 1; k < parts; ++k) {
+        const T& key = large[large.size() * k / parts];
+        cuts.push_back(lower_bound(data.begin() + cuts.back(), data.end(), key) - data.begin());
+        cutsS.push_back(lower_bound(S.data.begin() + cutsS.back(), S.data.end(), key) - S.data.begin());
+    }
+    cuts.push_back(data.size());
+    cutsS.push_back(S.data.size());
+}
+
+template <class T>
+void FlatSet<T>::parallel_union(const FlatSet& S) {
+    vector<size_t> cuts, cutsS;
+    partition(S, cuts, cutsS);
+    size_t parts = cuts.size() - 1;
+
+    // Each part is merged into a buffer of its own
+    vector<vector<T>> part(parts);
+    vector<thread> pool;
+    for (size_t k = 0; k < parts; ++k) {
+        pool.emplace_back([&, k]() {
+            part[k].reserve(cuts[k + 1] - cuts[k] + cutsS[k + 1] - cutsS[k]);
+            set_union(data.begin() + cuts[k], data.begin() + cuts[k + 1],
+                      S.data.begin() + cutsS[k], S.data.begin() + cutsS[k + 1],
+                      back_inserter(part[k]));
+        });
+    }
+    for (thread& t : pool) t.join();
+
+    // and then moved to its place in the result, also in parallel
+    vector<size_t> offset(parts + 1, 0);
+    for (size_t k = 0; k < parts; ++k) {
+        offset[k + 1] = offset[k] + part[k].size();
+    }
+
+    vector<T> ret(offset[parts]);
+    pool.clear();
+    for (size_t k = 0; k < parts; ++k) {
+        pool.emplace_back([&, k]() {
+            move(part[k].begin(), part[k].end(), ret.begin() + offset[k]);
+        });
+    }
+    for (thread& t : pool) t.join();
+
+    std::swap(data, ret);
+}
+
+template <class T>
+void FlatSet<T>::parallel_intersection(const FlatSet& S) {
+    vector<size_t> cuts, cutsS;
+    partition(S, cuts, cutsS);
+    size_t parts = cuts.size() - 1;
+
+    // Each part is intersected in place, within its own range of data
+    vector<size_t> kept(parts);
+    vector<thread> pool;
+    for (size_t k = 0; k < parts; ++k) {
+        pool.emplace_back([&, k]() {
+            kept[k] = intersect(data.data() + cuts[k], cuts[k + 1] - cuts[k],
+                                S.data.data() + cutsS[k], cutsS[k + 1] - cutsS[k]);
+        });
+    }
+    for (thread& t : pool) t.join();
+
+    // Close the gaps between the parts
+    size_t w = kept[0];
+    for (size_t k = 1; k < parts; ++k) {
+        w = move(data.begin() + cuts[k], data.begin() + cuts[k] + kept[k], data.begin() + w) - data.begin();
+    }
+    data.erase(data.begin() + w, data.end());
+}
+
+/*
+* Operators
+*/
+template <class T>
+const FlatSet<T>& FlatSet<T>::operator=(FlatSet S) {
+    std::swap(data, S.data);
+    return *this;
+}
+
+template <class T>
+const FlatSet<T>& FlatSet<T>::operator+=(const FlatSet & S) {
+    if (S.data.empty() || &S == this) return *this;
+
+    if (skewed(data.size(), S.data.size()) || skewed(S.data.size(), data.size())) {
+        // Gallop through the large set to where each element of the small one goes,
+        // the runs in between are copied as they are
+        const vector<T>& small = (data.size() < S.data.size()) ? data : S.data;
+        const vector<T>& large = (data.size() < S.data.size()) ? S.data : data;
+        vector<T> ret;
+        ret.reserve(data.size() + S.data.size());
+
+        size_t pos = 0;
+        for (const T& x : small) {
+            size_t next = gallop(large, pos, x);
+            ret.insert(ret.end(), large.begin() + pos, large.begin() + next);
+            if (next == large.size() || x < large[next]) ret.push_back(x);
+            pos = next;
+        }
+        ret.insert(ret.end(), large.begin() + pos, large.end());
+        std::swap(data, ret);
+        return *this;
+    }
+
+    if (use_threads(S)) {
+        parallel_union(S);
+        return *this;
+    }
+
+    // The result can not be built in place, merge into a new buffer
+    vector<T> ret;
+    ret.reserve(data.size() + S.data.size());
+    set_union(make_move_iterator(data.begin()), make_move_iterator(data.end()),
+              S.data.begin(), S.data.end(), back_inserter(ret));
+    std::swap(data, ret);
+    return *this;
+}
+
+template <class T>
+const FlatSet<T>& FlatSet<T>::operator*=(const FlatSet & S) {
+    if (&S == this) return *this;
+
+    if (skewed(data.size(), S.data.size())) {
+        // Look up each element of this set in S
+        size_t w = 0, pos = 0;
+        for (size_t i = 0; i < data.size(); ++i) {
+            pos = gallop(S.data, pos, data[i]);
+            if (pos == S.data.size()) break;
+            if (!(data[i] < S.data[pos])) {
+                if (w != i) data[w] = std::move(data[i]);
+                w++;
+            }
+        }
+        data.erase(data.begin() + w, data.end());
+        return *this;
+    }
+
+    if (skewed(S.data.size(), data.size())) {
+        // Look up each element of S in this set, only those found are kept
+        size_t w = 0, pos = 0;
+        for (const T& x : S.data) {
+            pos = gallop(data, pos, x);
+            if (pos == data.size()) break;
+            if (!(x < data[pos])) {
+                if (w != pos) data[w] = std::move(data[pos]);
+                w++;
+                pos++;
+            }
+        }
+        data.erase(data.begin() + w, data.end());
+        return *this;
+    }
+
+    if (use_threads(S)) {
+        parallel_intersection(S);
+        return *this;
+    }
+
+    data.erase(data.begin() + intersect(data.data(), data.size(), S.data.data(), S.data.size()), data.end());
+    return *this;
+}
+
+template <class T>
+const FlatSet<T>& FlatSet<T>::operator-=(const FlatSet & S) {
+    if (&S == this) {
+        data.clear();
+        return *this;
+    }
+
+    if (skewed(data.size(), S.data.size())) {
+        // Look up each element of this set in S, keep those not found
+        size_t w = 0, pos = 0;
+        for (size_t i = 0; i < data.size(); ++i) {
+            pos = gallop(S.data, pos, data[i]);
+            if (pos == S.data.size() || data[i] < S.data[pos]) {
+                if (w != i) data[w] = std::move(data[i]);
+                w++;
+            }
+        }
+        data.erase(data.begin() + w, data.end());
+        return *this;
+    }
+
+    if (skewed(S.data.size(), data.size())) {
+        // Look up each element of S in this set, the runs in between are moved down
+        size_t w = 0, pos = 0;
+        for (const T& x : S.data) {
+            size_t next = gallop(data, pos, x);
+            w = move(data.begin() + pos, data.begin() + next, data.begin() + w) - data.begin();
+            pos = next;
+            if (pos == data.size()) break;
+            if (!(x < data[pos])) pos++;
+        }
+        w = move(data.begin() + pos, data.end(), data.begin() + w) - data.begin();
+        data.erase(data.begin() + w, data.end());
+        return *this;
+    }
+
+    if constexpr (use_simd) {
+        data.resize(difference_sorted(data.data(), data.size(), S.data.data(), S.data.size(), data.data()));
+        return *this;
+    }
+
+    size_t w = 0, i = 0, j = 0;
+    while (i < data.size() && j < S.data.size()) {
+        if (data[i] < S.data[j]) {
+            if (w != i) data[w] = std::move(data[i]);
+            w++; i++;
+        } else if (S.data[j] < data[i]) {
+            j++;
+        } else {
+            // Element in S, drop it
+            i++; j++;
+        }
+    }
+    // Everything after the end of S is kept
+    w = move(data.begin() + i, data.end(), data.begin() + w) - data.begin();
+    data.erase(data.begin() + w, data.end());
+    return *this;
+}
+
+template <class T>
+bool FlatSet<T>::operator<=(const FlatSet& S) const {
+    if (data.size() > S.data.size()) return false;
+
+    if (skewed(data.size(), S.data.size())) {
+        size_t pos = 0;
+        for (const T& x : data) {
+            pos = gallop(S.data, pos, x);
+            if (pos == S.data.size() || x < S.data[pos]) return false;
+            pos++;
+        }
+        return true;
+    }
+
+    return includes(S.data.begin(), S.data.end(), data.begin(), data.end());
+}
+
+template <class T>
+bool FlatSet<T>::operator<(const FlatSet& S) const {
+    return data.size() < S.data.size() && *this <= S;
+}
+
+template <class T>
+bool FlatSet<T>::operator==(const FlatSet& S) const {
+    return data == S.data;
+}
+
+template <class T>
+bool FlatSet<T>::operator!=(const FlatSet& S) const {
+    return !(*this == S);
+}
+#endif // FLAT_SET_H
@@ -0,0 +1,298 @@
+#ifndef MAPPED_SET_H
+#define MAPPED_SET_H
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <type_traits>
+#include <atomic>
+
+#if defined(_WIN32)
+#define MAPPED_SET_READ
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "Set.h"
+#include "SetExpr.h"
+#include "set_file.h"
+
+using namespace std;
+
+template <class T> class MappedSet;
+
+// Leaf of an expression, refers to a mapped set
+template <class T>
+class MappedRef {
+public:
+    MappedRef(const MappedSet<T>& M) : set(&M) {}
+
+    typedef typename MappedSet<T>::cursor cursor;
+    cursor begin() const { return set->begin(); }
+
+private:
+    const MappedSet<T>* set;
+};
+
+// A mapped set is an expression leaf too, see leaf_of in SetExpr.h
+template <class T> struct leaf_of<T, MappedSet<T>> { typedef MappedRef<T> type; };
+
+/*
+* Read-only view of a set file written by Set<T>::save, see set_file.h.
+*
+* The file is mapped into memory and used where it is. Opening reads the header and checks
+* the block table of a delta file, O(blocks), the elements and their varints are only read
+* when they are used. A varint that is too long is found when its block is decoded.
+* is_member is a binary search, over the elements or over the block table of a delta file.
+* A mapped set is a leaf of the lazy set expressions, M + S, M * E, ... with S a Set and E
+* an expression stream the file once, and converting the expression to a Set gives the result.
+*
+* Where mmap is not available the file is read into a buffer instead.
+*/
+template <class T>
+class MappedSet{
+    static_assert(is_trivially_copyable<T>::value, "only trivially copyable elements can be mapped");
+
+public:
+    // Constructors
+    MappedSet(const string& path);
+    MappedSet(const MappedSet& R) = delete;
+    ~MappedSet();
+
+    // Member functions
+    // False when the file could not be opened, or is not a set file for T.
+    // Also false once a damaged delta block has been decoded, the walk or lookup stopped there
+    bool good() const;
+    int cardinality() const;
+    bool is_member(const T & v) const;
+
+    // Yields the elements in increasing order, as the cursors in SetExpr.h
+    class cursor {
+    public:
+        cursor(const MappedSet* M) : set(M), i(0) { load(); }
+
+        bool done() const { return i >= set->count; }
+        const T& value() const { return x; }
+        void next() { ++i; load(); }
+
+    private:
+        // Element i, the next difference is decoded within a block
+        void load() {
+            if (done()) return;
+            if (!set->blocks) {
+                x = set->elements[i];
+            } else if (i % DELTA_BLOCK == 0) {
+                x = set->blocks[i / DELTA_BLOCK].first;
+                p = set->bytes + set->blocks[i / DELTA_BLOCK].offset;
+            } else if (!next_in_block(x, p)) {
+                // Damaged block, end the walk here
+                set->damaged = true;
+                i = set->count;
+            }
+        }
+
+        const MappedSet* set;
+        size_t i;
+        T x{};
+        const uint8_t* p = nullptr;
+    };
+
+    cursor begin() const { return cursor(this); }
+
+    // Operators, lazy as the operators of Set
+    // Other operands can be a Set, a range of a Set, a MappedSet or an expression
+    template <class X>
+    friend SetExpr<T, UnionCursor, MappedRef<T>, operand_t<T, X>> operator+(const MappedSet& M, X&& S) {
+        return { M, std::forward<X>(S) };
+    }
+    template <class X, class = enable_if_t<!is_same<decay_t<X>, MappedSet>::value>>
+    friend SetExpr<T, UnionCursor, operand_t<T, X>, MappedRef<T>> operator+(X&& S, const MappedSet& M) {
+        return { std::forward<X>(S), M };
+    }
+
+    template <class X>
+    friend SetExpr<T, IntersectionCursor, MappedRef<T>, operand_t<T, X>> operator*(const MappedSet& M, X&& S) {
+        return { M, std::forward<X>(S) };
+    }
+    template <class X, class = enable_if_t<!is_same<decay_t<X>, MappedSet>::value>>
+    friend SetExpr<T, IntersectionCursor, operand_t<T, X>, MappedRef<T>> operator*(X&& S, const MappedSet& M) {
+        return { std::forward<X>(S), M };
+    }
+
+    template <class X>
+    friend SetExpr<T, DifferenceCursor, MappedRef<T>, operand_t<T, X>> operator-(const MappedSet& M, X&& S) {
+        return { M, std::forward<X>(S) };
+    }
+    template <class X, class = enable_if_t<!is_same<decay_t<X>, MappedSet>::value>>
+    friend SetExpr<T, DifferenceCursor, operand_t<T, X>, MappedRef<T>> operator-(X&& S, const MappedSet& M) {
+        return { std::forward<X>(S), M };
+    }
+
+    // Formatted output operator<<
+    friend ostream& operator<<(ostream& os, const MappedSet<T> & M){
+        os << "{ ";
+        for (cursor c = M.begin(); !c.done(); c.next()) {
+            os << c.value() << " ";
+        }
+        os << "}";
+        return os;
+    }
+
+private:
+    // Advances x to the next element of a delta block, p points at its difference and is
+    // advanced past it. Returns false when the difference is not a valid varint
+    static bool next_in_block(T& x, const uint8_t*& p) {
+        if constexpr (is_integral<T>::value) {
+            uint64_t d;
+            if (!get_varint(p, d)) return false;
+            x = add_delta(x, d);
+        }
+        return true;
+    }
+
+    // Checks the header and the sizes, and finds the sections of the file
+    bool parse();
+
+    bool ok = false;
+    mutable atomic<bool> damaged{false};    // set by const readers, see good()
+    const char* base = nullptr;     // the whole file
+    size_t size = 0;
+#ifdef MAPPED_SET_READ
+    vector<char> buffer;
+#endif
+
+    size_t count = 0;
+    const T* elements = nullptr;                // plain files
+    const DeltaBlock<T>* blocks = nullptr;      // delta files
+    size_t nblocks = 0;
+    const uint8_t* bytes = nullptr;
+};
+
+/*
+ * Constructors
+ */
+template <class T>
+MappedSet<T>::MappedSet(const string& path) {
+#ifdef MAPPED_SET_READ
+    ifstream file(path, ios::binary);
+    if (!file) return;
+    buffer.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    base = buffer.data();
+    size = buffer.size();
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) {
+            base = (const char*)p;
+            size = (size_t)st.st_size;
+        }
+    }
+    // The mapping stays valid after the file is closed
+    close(fd);
+#endif
+
+    ok = base && parse();
+    if (!ok) count = 0;
+}
+
+template <class T>
+MappedSet<T>::~MappedSet() {
+#ifndef MAPPED_SET_READ
+    if (base) munmap((void*)base, size);
+#endif
+}
+
+/*
+* Puclic member functions
+*/
+template <class T>
+bool MappedSet<T>::good() const {
+    return ok && !damaged;
+}
+
+template <class T>
+int MappedSet<T>::cardinality() const {
+    return (int)count;
+}
+
+template <class T>
+bool MappedSet<T>::is_member(const T & v) const {
+    if (count == 0) return false;
+    if (!blocks) {
+        return binary_search(elements, elements + count, v);
+    }
+
+    // Last block that starts at or before v, then decode it
+    const DeltaBlock<T>* b = upper_bound(blocks, blocks + nblocks, v,
+                                         [](const T& x, const DeltaBlock<T>& e) { return x < e.first; });
+    if (b == blocks) return false;
+    --b;
+
+    size_t i = (b - blocks) * DELTA_BLOCK;
+    size_t last = min(i + DELTA_BLOCK, count);
+    const uint8_t* p = bytes + b->offset;
+    T x = b->first;
+    while (x < v && ++i < last) {
+        if (!next_in_block(x, p)) {
+            damaged = true;
+            return false;
+        }
+    }
+    return x == v;
+}
+
+/*
+* Private member functions
+*/
+template <class T>
+bool MappedSet<T>::parse() {
+    if (size < sizeof(SetFileHeader)) return false;
+
+    SetFileHeader h;
+    memcpy(&h, base, sizeof(h));
+    if (memcmp(h.magic, SET_FILE_MAGIC, 4) != 0 || h.version != SET_FILE_VERSION || h.elem_size != sizeof(T)) {
+        return false;
+    }
+
+    const char* data = base + sizeof(SetFileHeader);
+    size_t left = size - sizeof(SetFileHeader);
+    count = (size_t)h.count;
+
+    if (h.flags == 0) {
+        if (count > left / sizeof(T)) return false;
+        elements = (const T*)data;
+        return true;
+    }
+
+    if (h.flags != SET_FILE_DELTA || !is_integral<T>::value) return false;
+    nblocks = (size_t)h.blocks;
+    if (nblocks != (count + DELTA_BLOCK - 1) / DELTA_BLOCK || nblocks > left / sizeof(DeltaBlock<T>)) {
+        return false;
+    }
+    if (nblocks == 0) return true;
+
+    blocks = (const DeltaBlock<T>*)data;
+    bytes = (const uint8_t*)(data + nblocks * sizeof(DeltaBlock<T>));
+    size_t nbytes = left - nblocks * sizeof(DeltaBlock<T>);
+
+    // Every difference takes at least one byte of its block. The stream has to end with the
+    // last byte of a varint, then decoding never reads past the end of the file.
+    // Only the table is checked, O(blocks), the varints are not read when the file is opened
+    for (size_t b = 0; b < nblocks; ++b) {
+        size_t n = min(DELTA_BLOCK, count - b * DELTA_BLOCK) - 1;
+        size_t end = (b + 1 < nblocks) ? (size_t)blocks[b + 1].offset : nbytes;
+        if (blocks[b].offset > end || end > nbytes || end - blocks[b].offset < n) return false;
+    }
+    return nbytes == 0 || !(bytes[nbytes - 1] & 0x80);
+}
+
+#endif // MAPPED_SET_H
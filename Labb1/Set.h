@@ -4,95 +4,393 @@
 #include <memory>
 #include <iostream>
 #include <utility>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <iterator>
+#include <thread>
+#include <cmath>
+#include <atomic>
+
+#include "SetExpr.h"
+#include "parallel_sort.h"
+#include "set_file.h"
+#include "set_stats.h"
 
 using namespace std;
 
+template <class T> class Set;
+
+// True when A&& and B&& bind two sets and at least one is a temporary,
+// a forwarding reference deduces a plain Set<T> only for rvalues
+template <class T, class A, class B>
+constexpr bool reuses_set_operand() {
+    return is_same<remove_cv_t<remove_reference_t<A>>, Set<T>>::value &&
+           is_same<remove_cv_t<remove_reference_t<B>>, Set<T>>::value &&
+           (is_same<A, Set<T>>::value || is_same<B, Set<T>>::value);
+}
+
+// True when A&& and B&& bind a set and a set or a value converted to a set,
+// the operands of the lazy operators, see set_operand in SetExpr.h
+template <class T, class A, class B>
+constexpr bool lazy_set_operands() {
+    return set_operand<T, A>() && set_operand<T, B>() &&
+           (is_same<remove_cv_t<remove_reference_t<A>>, Set<T>>::value ||
+            is_same<remove_cv_t<remove_reference_t<B>>, Set<T>>::value);
+}
+
 template <class T>
 class Set{
 public:
+    // Elements can not be changed in place, that would break the order
+    typedef SetIterator<T> const_iterator;
+    typedef const_iterator iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+    typedef const_reverse_iterator reverse_iterator;
+
     // Constructors
     Set();                  // Default
     Set(const T& v);        // Type conversion
     Set(const Set& R);      // Copy
     Set(Set&& S) noexcept;  // Move
+    ~Set();                 // Destructor
     Set(T a[], int n);    // Conversion from sorded array
 
+    // Conversion from any range, unsorted and with duplicates. Sorted in parallel
+    template <class It, class = typename iterator_traits<It>::iterator_category>
+    Set(It first, It last, unsigned threads = thread::hardware_concurrency());
+
+    template <class Range>
+    static Set from_range(const Range& r, unsigned threads = thread::hardware_concurrency()) {
+        return Set(std::begin(r), std::end(r), threads);
+    }
+
+    // Evaluation of a set expression, see SetExpr.h
+    template <template <class, class, class> class C, class L, class R>
+    Set(const SetExpr<T, C, L, R>& E);
+
+    // Copy of the elements in a range of a set
+    Set(const SetRange<T>& R);
+
+    // Union and intersection of all the sets in a range, merged in one pass
+    template <class Range>
+    static Set union_all(const Range& sets);
+    template <class Range>
+    static Set intersect_all(const Range& sets);
+
     // Member functions
-    int cardinality();
-    bool is_member(const T & v);
+    int cardinality() const;
+    bool is_member(const T & v) const;
     void make_empty();
-    bool _empty();
+    bool _empty() const;
+
+    // Skip-list index over the node chain, off by default.
+    // With the index is_member and insert are O(log n), the set operators stay linear merges
+    void use_index(bool on = true);
+    void insert(const T& v);   // Insert v at its place in the set
+    void remove(const T& v);   // Remove v, if it is in the set
+
+    // Membership of a whole batch of values: found[i] is set when the i-th value is in the set.
+    // A sorted batch is answered in one merge pass over the set. An unsorted batch is sorted
+    // first, unless looking the values up one by one is cheaper
+    template <class It>
+    void contains_many(It first, It last, vector<bool>& found) const;
+
+    // Iterators, in increasing order. Valid until the set is changed
+    const_iterator begin() const { return const_iterator(this, node(HEAD).next, TAIL); }
+    const_iterator end() const { return const_iterator(this, TAIL, TAIL); }
+    const_reverse_iterator rbegin() const { return const_reverse_iterator(end()); }
+    const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+
+    // First element not less than v, and first element greater than v.
+    // O(log n) with the skip-list index, linear without it
+    const_iterator lower_bound(const T& v) const;
+    const_iterator upper_bound(const T& v) const;
+
+    // Elements in [lo, hi), without copying them. A range is an operand of the set
+    // operators, A.range(lo, hi) * B intersects only within [lo, hi)
+    SetRange<T> range(const T& lo, const T& hi) const;
+
+    // Writes the set to a binary file that MappedSet can map, see set_file.h.
+    // Only for trivially copyable T. delta encoding is used for integral T only.
+    // Returns false when the file could not be written
+    bool save(const string& path, bool delta = false) const;
+
+    // Counters of this set, see set_stats.h. Only counted when built with SET_STATS
+    SetStats stats() const;
+    void reset_stats();
 
     // Operators
     const Set& operator=(Set S);          // Assignment
     const Set& operator+=(const Set & S); // Union
+    const Set& operator+=(Set && S);      // Union, takes the elements of S
     const Set& operator*=(const Set & S); // Intersection
     const Set& operator-=(const Set & S); // Difference
 
-    friend Set operator+(const Set& L, const Set& R) {
-        Set<T> ret(L);
-        return ret += R;
+    // Lazy, the result is computed when the expression is converted to a Set.
+    // A named set is referred to, a temporary set or a value, as in A + 4, is kept in the expression
+    template <class A, class B, class = enable_if_t<lazy_set_operands<T, A, B>() && !reuses_set_operand<T, A, B>()>>
+    friend SetExpr<T, UnionCursor, operand_t<T, A>, operand_t<T, B>> operator+(A&& L, B&& R) {
+        return { std::forward<A>(L), std::forward<B>(R) };
     };
 
-    friend Set operator*(const Set& L, const Set& R) {
-        Set<T> ret(L);
-        return ret *= R;
+    template <class A, class B, class = enable_if_t<lazy_set_operands<T, A, B>() && !reuses_set_operand<T, A, B>()>>
+    friend SetExpr<T, IntersectionCursor, operand_t<T, A>, operand_t<T, B>> operator*(A&& L, B&& R) {
+        return { std::forward<A>(L), std::forward<B>(R) };
     };
 
-    friend Set operator-(const Set& L, const Set& R) {
-        Set<T> ret(L);
-        return ret -= R;
+    template <class A, class B, class = enable_if_t<lazy_set_operands<T, A, B>() && !(reuses_set_operand<T, A, B>() && is_same<A, Set>::value)>>
+    friend SetExpr<T, DifferenceCursor, operand_t<T, A>, operand_t<T, B>> operator-(A&& L, B&& R) {
+        return { std::forward<A>(L), std::forward<B>(R) };
     };
 
-    bool operator<=(Set& S);
-    bool operator<(Set& S);
-    bool operator==(Set& S);
-    bool operator!=(Set& S);
+    // When an operand is a temporary set the result is computed at once in its storage,
+    // as in f() + g() or std::move(A) * B. Only chosen when the operands are sets,
+    // mixed-mode arithmetic and expressions still use the lazy operators above
+    template <class A, class B, class = enable_if_t<reuses_set_operand<T, A, B>()>>
+    friend Set operator+(A&& L, B&& R) {
+        if constexpr (is_same<A, Set>::value) {
+            L += std::forward<B>(R);
+            return std::move(L);
+        } else {
+            R += L;
+            return std::move(R);
+        }
+    };
+
+    template <class A, class B, class = enable_if_t<reuses_set_operand<T, A, B>()>>
+    friend Set operator*(A&& L, B&& R) {
+        if constexpr (is_same<A, Set>::value) {
+            L *= R;
+            return std::move(L);
+        } else {
+            R *= L;
+            return std::move(R);
+        }
+    };
+
+    // Difference is not commutative, only a temporary left operand can be reused
+    template <class A, class B, class = enable_if_t<reuses_set_operand<T, A, B>() && is_same<A, Set>::value>>
+    friend Set operator-(A&& L, B&& R) {
+        L -= R;
+        return std::move(L);
+    };
+
+    // Each comparison is one merge pass that stops at the first element that decides it
+    bool operator<=(const Set& S) const;
+    bool operator<(const Set& S) const;
+    bool operator==(const Set& S) const;
+    bool operator!=(const Set& S) const;
 
 
     // Formatted output operator<<
     friend ostream& operator<<(ostream& os, const Set<T> & S){
-        auto tmp = S.head->next;
+        int tmp = S.node(HEAD).next;
         os << "{ ";
-        while (tmp->next != nullptr){
-            os << tmp->data << " ";
-            tmp = tmp->next;
+        while (tmp != TAIL){
+            os << S.node(tmp).data << " ";
+            tmp = S.node(tmp).next;
         }
         os << "}";
         return os;
     }
 
 private:
+    // Expressions walk the nodes of their operands
+    friend class SetRef<T>;
+    friend class SetIterator<T>;
+
+    // Union with S. When S is an rvalue its elements are moved instead of copied
+    template <class S_>
+    void unite(S_&& S);
+
     //class Node
+    //Nodes live in the set's arena, prev and next are indices into it
     class Node {
     public:
-        Node(const T & d = T{}, shared_ptr<Node> p = nullptr, shared_ptr<Node> n = nullptr)
+        Node(const T & d = T{}, int p = NIL, int n = NIL)
             : data {d}, prev{p}, next{n} {}
 
-        Node(const T && d, shared_ptr<Node> p = nullptr, shared_ptr<Node> n = nullptr)
+        Node(T && d, int p = NIL, int n = NIL)
             : data{move(d)}, prev{p}, next{n} {}
 
         T data;
-        weak_ptr<Node> prev;
-        shared_ptr<Node> next;
+        int prev;
+        int next;
     };
 
+    // Index of no node, and of the two sentinels that are always first in the arena
+    static constexpr int NIL = -1;
+    static constexpr int HEAD = 0;
+    static constexpr int TAIL = 1;
+
+    // Elements that fit in the set object itself, larger sets move their nodes to the heap
+    static constexpr int SMALL = 8;
+
+    const Node& node(int n) const { return heap ? (*heap)[n] : small[n]; }
+    Node& node(int n) { return heap ? (*heap)[n] : small[n]; }
+
+    // Number of nodes in the arena, free ones included
+    int arena_size() const { return heap ? (int)heap->size() : small_size; }
+
+    // Copies share the heap arena until one of them changes. Called before every change,
+    // the set then gets its own copy of the arena. Node indices are the same in the copy
+    void detach() {
+        if (!heap) return;
+        if (heap.use_count() > 1) {
+            heap = make_shared<vector<Node>>(*heap);
+            SET_STAT(counters.nodes_allocated += heap->size());
+        } else {
+            // A copy on another thread may just have been dropped. use_count is a relaxed
+            // read, the fence orders that thread's reads of the arena before our writes
+            atomic_thread_fence(memory_order_acquire);
+        }
+    }
+
+    // The towers of the index are shared by copies in the same way, called before they change
+    void detach_index() {
+        if (up.use_count() > 1) {
+            up = make_shared<vector<vector<int>>>(*up);
+        } else {
+            atomic_thread_fence(memory_order_acquire);
+        }
+    }
+
+    // Room for n nodes. Past SMALL elements the nodes are moved to the heap
+    void reserve(size_t n) {
+        if (heap) {
+            detach();
+            heap->reserve(n);
+        } else if (n > SMALL + 2) {
+            heap = make_shared<vector<Node>>();
+            heap->reserve(n);
+            for (int i = 0; i < small_size; ++i) heap->push_back(std::move(small[i]));
+            destroy(small, small + small_size);
+            small_size = 0;
+        }
+    }
+
+    // Take a node from the free list, or grow the arena by one node
+    template <class V>
+    int new_node(V&& v, int p, int n) {
+        SET_STAT(counters.nodes_allocated++);
+        if (free_list != NIL) {
+            int tmp = free_list;
+            free_list = node(tmp).next;
+            node(tmp).data = std::forward<V>(v);
+            node(tmp).prev = p;
+            node(tmp).next = n;
+            return tmp;
+        }
+        if (!heap && small_size == SMALL + 2) reserve(2 * (SMALL + 2));
+        if (!heap) {
+            new (&small[small_size]) Node(std::forward<V>(v), p, n);
+            return small_size++;
+        }
+        heap->emplace_back(std::forward<V>(v), p, n);
+        return (int)heap->size() - 1;
+    }
+
+    // Back to an empty set in the inline arena
+    void reset();
+
+    // Node of the first element not less than v, or TAIL
+    int first_not_less(const T& v) const;
+
     // Helper functions to manage insertion/removal
-    void insert_after(shared_ptr<Node> p, const T& v) {
-        auto tmp = make_shared<Node>(v, p, p->next);
-        p->next->prev = tmp;
-        p->next = tmp;
+    // Both leave the skip-list index out of date, the member function that changes
+    // the chain brings it up to date with update_index before it returns
+    template <class V>
+    int insert_after(int p, V&& v) {
+        detach();
+        int tmp = new_node(std::forward<V>(v), p, node(p).next);
+        node(node(p).next).prev = tmp;
+        node(p).next = tmp;
+        count++;
+        index_stale = true;
+        return tmp;
     };
     /*
-    * Removes node n and returns a pointer to the node that was after the removed node
+    * Unlinks node n and puts it on the free list
     */
-    void remove_node(shared_ptr<Node> n) {
-        auto p = n->prev.lock();
-        p->next = n->next;
-        n->next->prev = n->prev;
+    void remove_node(int n) {
+        detach();
+        int p = node(n).prev;
+        node(p).next = node(n).next;
+        node(node(n).next).prev = p;
+        node(n).next = free_list;
+        free_list = n;
+        count--;
+        SET_STAT(counters.nodes_freed++);
+        index_stale = true;
+    };
+
+    // Exchange the elements and their skip-list towers with S
+    void swap_storage(Set& S) {
+        // Swap the inline nodes both sets have, move the rest of the longer arena over
+        int common = min(small_size, S.small_size);
+        for (int i = 0; i < common; ++i) std::swap(small[i], S.small[i]);
+        uninitialized_move(small + common, small + small_size, S.small + common);
+        uninitialized_move(S.small + common, S.small + S.small_size, small + common);
+        destroy(small + common, small + small_size);
+        destroy(S.small + common, S.small + S.small_size);
+
+        std::swap(heap, S.heap);
+        std::swap(small_size, S.small_size);
+        std::swap(free_list, S.free_list);
+        std::swap(count, S.count);
+        std::swap(up, S.up);
+        std::swap(index_stale, S.index_stale);
+    }
+
+    // Skip-list index helpers
+    static constexpr int MAX_LEVEL = 16;
+
+    // Link of node n at level l >= 1
+    int& link(int n, int l) { return (*up)[n][l - 1]; }
+    int link(int n, int l) const { return (*up)[n][l - 1]; }
+
+    // Last node before v on each level, returns the one on level 0
+    // Steps are counted as comparisons of op
+    int find_before(const T& v, int before[], [[maybe_unused]] SetOp op) const;
+    void build_index();
+    int random_level();
+
+    // Rebuilds the index when the chain has changed, or drops it when it is off
+    void update_index();
+
+    // Arena with every node of the set, node(HEAD) and node(TAIL) are the sentinels.
+    // A small set keeps its nodes in small, without allocating. Once it grows past SMALL
+    // elements they move to heap, which copies of the set share
+    // Destroying or emptying the set releases it in one go, without walking the chain
+    // small is raw storage, only its first small_size nodes are constructed, and none
+    // once the nodes are on the heap. A new set constructs only its two sentinels
+    union {
+        Node small[SMALL + 2];
     };
+    int small_size = 0;
+    shared_ptr<vector<Node>> heap;
+
+    // Chain of unlinked nodes that can be reused, linked through next
+    int free_list = NIL;
+
+    // Number of elements, kept up to date by insert_after and remove_node
+    int count = 0;
+
+    // Skip-list towers, (*up)[n][l-1] is the next node after n on level l >= 1, null without the index.
+    // Level 0 is the chain itself. Every member function that changes the chain
+    // updates the index before it returns, so the const member functions only read it
+    // and a const set can be searched from several threads at once. Not when built with
+    // SET_STATS, the lookups then also count in the counters, without synchronization.
+    // Copies share the towers as they share the heap arena, until one of them changes
+    bool indexed = false;
+    bool index_stale = true;
+    shared_ptr<vector<vector<int>>> up;
+    unsigned seed = 2463534242u;
 
-    shared_ptr<Node> head, tail;
+#ifdef SET_STATS
+    mutable SetStats counters;
+#endif
 };
 
 /*
@@ -100,42 +398,84 @@ private:
  */
 template <class T>
 Set<T>::Set() {
-    head = make_shared<Node>();
-    tail = make_shared<Node>();
-    head->next = tail;
-    tail->prev = head;
+    reset();
 }
 
 template <class T>
 Set<T>::Set(const T& v) : Set() {
-    head->next = make_shared<Node>(v, head, tail);
-    tail->prev = head->next;
+    insert_after(HEAD, v);
 }
 
+// O(1), a heap arena and the towers of the index are shared with R until one of the two sets changes.
+// An inline arena is at most SMALL + 2 nodes and is copied
 template<class T>
-Set<T>::Set(const Set& R): Set() {
-    auto tmpR = R.head->next;
-    auto tmpS = head;
-    while(tmpR->next != nullptr){
-        tmpS->next = make_shared<Node>(tmpR->data, tmpS, tmpS->next);
-        tmpR = tmpR->next;
-        tmpS = tmpS->next;
-    }
+Set<T>::Set(const Set& R)
+    : small_size(R.small_size), heap(R.heap), free_list(R.free_list), count(R.count),
+      indexed(R.indexed), index_stale(R.index_stale), up(R.up) {
+    if (!heap) uninitialized_copy(R.small, R.small + small_size, small);
+}
+
+// The moved-from set is left empty
+template<class T>
+Set<T>::Set(Set&& S) noexcept
+    : small_size(S.small_size), heap(std::move(S.heap)), free_list(S.free_list), count(S.count),
+      indexed(S.indexed), index_stale(S.index_stale), up(std::move(S.up)) {
+    if (!heap) uninitialized_move(S.small, S.small + small_size, small);
+    S.reset();
+    S.update_index();
 }
 
+// The inline nodes are destroyed here, a heap arena with its shared_ptr
 template<class T>
-Set<T>::Set(Set&& S) noexcept : head(std::move(S.head)), tail(std::move(S.tail)) {
-    S.head = nullptr;
-    S.tail = nullptr;
+Set<T>::~Set() {
+    destroy(small, small + small_size);
 }
 
 template<class T>
 Set<T>::Set(T a[], int n): Set() {
-    auto tmp = head;
+    reserve(n + 2);
+    int tmp = HEAD;
     int i = 0;
     while(i < n){
         insert_after(tmp, a[i++]);
-        tmp = tmp->next;
+        tmp = node(tmp).next;
+    }
+}
+
+template<class T>
+template<class It, class>
+Set<T>::Set(It first, It last, unsigned threads): Set() {
+    vector<T> v(first, last);
+    parallel_sort_unique(v, threads);
+
+    // One pass, appending at the end
+    reserve(v.size() + 2);
+    int tmp = HEAD;
+    for (T& x : v) {
+        insert_after(tmp, std::move(x));
+        tmp = node(tmp).next;
+    }
+}
+
+template<class T>
+template <template <class, class, class> class C, class L, class R>
+Set<T>::Set(const SetExpr<T, C, L, R>& E): Set() {
+    SET_STAT(SetStatsTimer timer(counters, OP_EVALUATE));
+
+    // The cursor yields the elements in order, append each one at the end
+    int last = HEAD;
+    for (auto c = E.begin(); !c.done(); c.next()) {
+        insert_after(last, c.value());
+        last = node(last).next;
+    }
+}
+
+template<class T>
+Set<T>::Set(const SetRange<T>& R): Set() {
+    int last = HEAD;
+    for (const T& v : R) {
+        insert_after(last, v);
+        last = node(last).next;
     }
 }
 
@@ -143,164 +483,601 @@ Set<T>::Set(T a[], int n): Set() {
 /*
 * Puclic member functions
 */
+
+// k-way merge: the cursors of all sets are kept in a min-heap ordered by their current
+// element, so each element costs O(log k). The result arena is allocated once, large
+// enough for every element of every set
 template<class T>
-int Set<T>::cardinality() {
-    auto tmp = head->next;
-    int i = 0;
-    while(tmp != tail){
-        i++;
-        tmp = tmp->next;
+template<class Range>
+Set<T> Set<T>::union_all(const Range& sets) {
+    typedef typename SetRef<T>::cursor Cursor;
+    vector<Cursor> cursors;
+    size_t total = 0;
+
+    for (const Set& S : sets) {
+        total += S.count;
+        Cursor c = SetRef<T>(S).begin();
+        if (!c.done()) cursors.push_back(c);
     }
-    return i;
+
+    auto later = [](const Cursor& a, const Cursor& b) { return b.value() < a.value(); };
+    make_heap(cursors.begin(), cursors.end(), later);
+
+    Set ret;
+    ret.reserve(total + 2);
+    int tmp = HEAD;
+
+    while (!cursors.empty()) {
+        pop_heap(cursors.begin(), cursors.end(), later);
+        Cursor& c = cursors.back();
+
+        // Equal elements come out of the heap one after the other, keep the first
+        if (tmp == HEAD || ret.node(tmp).data < c.value()) {
+            ret.insert_after(tmp, c.value());
+            tmp = ret.node(tmp).next;
+        }
+
+        c.next();
+        if (c.done()) {
+            cursors.pop_back();
+        } else {
+            push_heap(cursors.begin(), cursors.end(), later);
+        }
+    }
+    return ret;
+}
+
+// Leapfrog: each cursor in turn is advanced to the current candidate, if it stops at a
+// larger element that element is the new candidate. A candidate every cursor agrees on
+// is in the intersection. The smallest set goes first, it proposes the fewest candidates
+template<class T>
+template<class Range>
+Set<T> Set<T>::intersect_all(const Range& sets) {
+    typedef typename SetRef<T>::cursor Cursor;
+    vector<pair<size_t, Cursor>> by_size;
+
+    for (const Set& S : sets) {
+        by_size.emplace_back(S.count, SetRef<T>(S).begin());
+        if (by_size.back().second.done()) return Set();
+    }
+    if (by_size.empty()) return Set();
+
+    stable_sort(by_size.begin(), by_size.end(),
+                [](const pair<size_t, Cursor>& a, const pair<size_t, Cursor>& b) { return a.first < b.first; });
+
+    vector<Cursor> cursors;
+    for (auto& p : by_size) cursors.push_back(p.second);
+
+    Set ret;
+    ret.reserve(by_size[0].first + 2);
+    int tmp = HEAD;
+
+    size_t n = cursors.size(), k = 0, agree = 0;
+    const T* x = &cursors[0].value();
+
+    while (true) {
+        Cursor& c = cursors[k];
+        while (!c.done() && c.value() < *x) c.next();
+        if (c.done()) break;
+
+        if (*x < c.value()) {
+            x = &c.value();
+            agree = 1;
+        } else if (++agree == n) {
+            ret.insert_after(tmp, *x);
+            tmp = ret.node(tmp).next;
+
+            // The next element of c is the new candidate, c agrees with it
+            // when it is visited again
+            c.next();
+            if (c.done()) break;
+            x = &c.value();
+            agree = 0;
+            continue;
+        }
+        k = (k + 1) % n;
+    }
+    return ret;
+}
+template<class T>
+int Set<T>::cardinality() const {
+    return count;
 }
 
 template<class T>
-bool Set<T>::is_member(const T & v) {
-    auto tmp = head->next;
-    while(tmp != tail){
-        if (tmp->data == v) {
+bool Set<T>::is_member(const T & v) const {
+    SET_STAT(SetStatsTimer timer(counters, OP_IS_MEMBER));
+
+    if (indexed) {
+        int before[MAX_LEVEL];
+        int n = node(find_before(v, before, OP_IS_MEMBER)).next;
+        return n != TAIL && node(n).data == v;
+    }
+
+    int tmp = node(HEAD).next;
+    while(tmp != TAIL){
+        SET_STAT(counters.comparisons[OP_IS_MEMBER]++);
+        if (node(tmp).data == v) {
             return true;
         }
-        tmp = tmp->next;
+        tmp = node(tmp).next;
     }
     return false;
 }
 
 template<class T>
-void Set<T>::make_empty() {
-    while(head->next != tail){
-        remove_node(head->next);
+template<class It>
+void Set<T>::contains_many(It first, It last, vector<bool>& found) const {
+    SET_STAT(SetStatsTimer timer(counters, OP_CONTAINS_MANY));
+
+    size_t k = distance(first, last);
+    found.assign(k, false);
+    if (k == 0) return;
+
+    // Estimated cost of looking the values up one by one, and of sorting the batch
+    double logn = log2((double)count + 2);
+    double each = (double)k * (indexed ? logn : count);
+    double sorting = (double)k * log2((double)k + 1);
+    bool sorted = is_sorted(first, last);
+
+    if (each < (sorted ? 0 : sorting) + count + k) {
+        size_t i = 0;
+        for (It it = first; it != last; ++it) found[i++] = is_member(*it);
+        return;
     }
+
+    // Walk the chain once, the values come in increasing order
+    int n = node(HEAD).next;
+    auto lookup = [&](const T& v) {
+        while (n != TAIL && node(n).data < v) {
+            SET_STAT(counters.comparisons[OP_CONTAINS_MANY]++);
+            n = node(n).next;
+        }
+        return n != TAIL && node(n).data == v;
+    };
+
+    if (sorted) {
+        size_t i = 0;
+        for (It it = first; it != last; ++it) found[i++] = lookup(*it);
+        return;
+    }
+
+    vector<T> values(first, last);
+    vector<size_t> order(k);
+    for (size_t i = 0; i < k; ++i) order[i] = i;
+    sort(order.begin(), order.end(), [&values](size_t a, size_t b) { return values[a] < values[b]; });
+
+    for (size_t i : order) found[i] = lookup(values[i]);
+}
+
+template<class T>
+bool Set<T>::save(const string& path, bool delta) const {
+    return write_set_file<T>(path, SetRef<T>(*this).begin(), count, delta);
+}
+
+template<class T>
+typename Set<T>::const_iterator Set<T>::lower_bound(const T& v) const {
+    return const_iterator(this, first_not_less(v), TAIL);
+}
+
+template<class T>
+typename Set<T>::const_iterator Set<T>::upper_bound(const T& v) const {
+    int n = first_not_less(v);
+    if (n != TAIL && !(v < node(n).data)) n = node(n).next;
+    return const_iterator(this, n, TAIL);
 }
+
+template<class T>
+SetRange<T> Set<T>::range(const T& lo, const T& hi) const {
+    int first = first_not_less(lo);
+    int last = (lo < hi) ? first_not_less(hi) : first;
+    return SetRange<T>(const_iterator(this, first, last), const_iterator(this, last, last));
+}
+
+// The counters are copied, the bytes resident are added up on each call
 template<class T>
-bool Set<T>::_empty(){
-    if(head->next == tail)return true;
+SetStats Set<T>::stats() const {
+    SetStats s;
+#ifdef SET_STATS
+    s = counters;
+    s.enabled = true;
+#endif
+    s.bytes_resident = sizeof(*this) + (heap ? heap->capacity() * sizeof(Node) : 0);
+    if (up) {
+        s.bytes_resident += up->capacity() * sizeof(vector<int>);
+        for (const vector<int>& tower : *up) s.bytes_resident += tower.capacity() * sizeof(int);
+    }
+    return s;
+}
+
+template<class T>
+void Set<T>::reset_stats() {
+#ifdef SET_STATS
+    counters = SetStats();
+#endif
+}
+
+template<class T>
+void Set<T>::use_index(bool on) {
+    indexed = on;
+    index_stale = true;
+    update_index();
+}
+
+template<class T>
+void Set<T>::insert(const T& v) {
+    SET_STAT(SetStatsTimer timer(counters, OP_INSERT));
+
+    int before[MAX_LEVEL];
+    int p = indexed ? find_before(v, before, OP_INSERT) : HEAD;
+
+    if (!indexed) {
+        // Linear search for the place
+        while (node(p).next != TAIL && node(node(p).next).data < v) {
+            SET_STAT(counters.comparisons[OP_INSERT]++);
+            p = node(p).next;
+        }
+    }
+    if (node(p).next != TAIL && node(node(p).next).data == v) return;
+
+    int n = insert_after(p, v);
+    if (!indexed) return;
+
+    // Give the new node a tower and link it in on every level it reaches
+    detach_index();
+    if ((int)up->size() < arena_size()) up->resize(arena_size());
+    int h = random_level();
+    (*up)[n].assign(h - 1, TAIL);
+    for (int l = 1; l < h; ++l) {
+        link(n, l) = link(before[l], l);
+        link(before[l], l) = n;
+    }
+    index_stale = false;
+}
+
+template<class T>
+void Set<T>::remove(const T& v) {
+    SET_STAT(SetStatsTimer timer(counters, OP_REMOVE));
+
+    int before[MAX_LEVEL];
+    int p = indexed ? find_before(v, before, OP_REMOVE) : HEAD;
+
+    if (!indexed) {
+        while (node(p).next != TAIL && node(node(p).next).data < v) {
+            SET_STAT(counters.comparisons[OP_REMOVE]++);
+            p = node(p).next;
+        }
+    }
+    int n = node(p).next;
+    if (n == TAIL || !(node(n).data == v)) return;
+
+    remove_node(n);
+    if (!indexed) return;
+
+    // Unlink the tower of n, on every level it reaches before[l] links to n
+    detach_index();
+    for (int l = 1; l <= (int)(*up)[n].size(); ++l) {
+        link(before[l], l) = link(n, l);
+    }
+    (*up)[n].clear();
+    index_stale = false;
+}
+
+// Drops the whole arena at once, the set goes back to the inline arena.
+// A shared heap arena is left to the other sets
+template<class T>
+void Set<T>::make_empty() {
+    SET_STAT(counters.nodes_freed += count);
+    reset();
+    update_index();
+}
+template<class T>
+bool Set<T>::_empty() const {
+    if(node(HEAD).next == TAIL)return true;
     else return false;
 }
 
 /*
-* Operators
+* Private member functions
 */
 template<class T>
-const Set<T>& Set<T>::operator=(Set S) {
-    std::swap(head, S.head);
-    std::swap(tail, S.tail);
-    return *this;
+void Set<T>::reset() {
+    destroy(small, small + small_size);
+    heap.reset();
+    new (&small[HEAD]) Node(T{}, NIL, TAIL);
+    new (&small[TAIL]) Node(T{}, HEAD, NIL);
+    small_size = 2;
+    free_list = NIL;
+    count = 0;
+    index_stale = true;
 }
 
 template<class T>
-const Set<T>& Set<T>::operator+=(const Set & S) {
-    auto tmpR = head;
-    auto tmpS = S.head;
-
-    while (tmpS->next != S.tail) {
-        if (tmpR->next == tail) {
-            insert_after(tmpR, tmpS->next->data);
-            tmpR = tmpR->next;
-            tmpS = tmpS->next;
-        } else if (tmpS->next->data > tmpR->next->data) {
+template<class S_>
+void Set<T>::unite(S_&& S) {
+    // Elements are moved out of S when S is an rvalue
+    typedef conditional_t<is_lvalue_reference<S_>::value, const T&, T&&> Elem;
+    SET_STAT(SetStatsTimer timer(counters, OP_UNION));
+
+    int tmpR = HEAD;
+    int tmpS = S.node(HEAD).next;
+
+    while (tmpS != TAIL) {
+        SET_STAT(counters.comparisons[OP_UNION]++);
+        int nextR = node(tmpR).next;
+        auto& v = S.node(tmpS).data;
+
+        if (nextR == TAIL) {
+            insert_after(tmpR, static_cast<Elem>(v));
+            tmpR = node(tmpR).next;
+            tmpS = S.node(tmpS).next;
+        } else if (v > node(nextR).data) {
             // Not the right place, advance R
-            tmpR = tmpR->next;
-        } else if (tmpS->next->data == tmpR->next->data) {
+            tmpR = nextR;
+        } else if (v == node(nextR).data) {
             // Element already in set
-            tmpS = tmpS->next;
-        } else if (tmpS->next->data < tmpR->next->data) {
+            tmpS = S.node(tmpS).next;
+        } else {
             // Insert element before tested element
-            insert_after(tmpR, tmpS->next->data);
-            tmpS = tmpS->next;
+            insert_after(tmpR, static_cast<Elem>(v));
+            tmpS = S.node(tmpS).next;
         }
     }
+}
 
+template<class T>
+int Set<T>::first_not_less(const T& v) const {
+    SET_STAT(SetStatsTimer timer(counters, OP_SEARCH));
+
+    if (indexed) {
+        int before[MAX_LEVEL];
+        return node(find_before(v, before, OP_SEARCH)).next;
+    }
+
+    int n = node(HEAD).next;
+    while (n != TAIL && node(n).data < v) {
+        SET_STAT(counters.comparisons[OP_SEARCH]++);
+        n = node(n).next;
+    }
+    return n;
+}
+
+// Walks down the levels from the top of HEAD's tower, as far right as the elements
+// are smaller than v
+template<class T>
+int Set<T>::find_before(const T& v, int before[], [[maybe_unused]] SetOp op) const {
+    int x = HEAD;
+    for (int l = MAX_LEVEL - 1; l >= 1; --l) {
+        while (link(x, l) != TAIL && node(link(x, l)).data < v) {
+            SET_STAT(counters.comparisons[op]++);
+            x = link(x, l);
+        }
+        before[l] = x;
+    }
+    while (node(x).next != TAIL && node(node(x).next).data < v) {
+        SET_STAT(counters.comparisons[op]++);
+        x = node(x).next;
+    }
+    before[0] = x;
+    return x;
+}
+
+// One pass over the chain. The k-th node gets a tower of 1 + (trailing zero bits of k) / 2
+// levels, so every level has a quarter of the nodes of the level below, evenly spread
+template<class T>
+void Set<T>::build_index() {
+    // New towers, the ones that copies may share are left to them
+    up = make_shared<vector<vector<int>>>(arena_size());
+    (*up)[HEAD].assign(MAX_LEVEL - 1, TAIL);
+
+    int last[MAX_LEVEL];
+    fill(last, last + MAX_LEVEL, (int)HEAD);
+
+    unsigned k = 1;
+    for (int n = node(HEAD).next; n != TAIL; n = node(n).next, ++k) {
+        int h = min(1 + __builtin_ctz(k) / 2, MAX_LEVEL);
+        (*up)[n].assign(h - 1, TAIL);
+        for (int l = 1; l < h; ++l) {
+            link(last[l], l) = n;
+            last[l] = n;
+        }
+    }
+    index_stale = false;
+}
+
+template<class T>
+void Set<T>::update_index() {
+    if (!indexed) {
+        // No towers, an assignment can give them to a set that uses the index
+        up.reset();
+        index_stale = true;
+    } else if (index_stale || !up) {
+        build_index();
+    }
+}
+
+// Each extra level with probability 1/4
+template<class T>
+int Set<T>::random_level() {
+    int h = 1;
+    while (h < MAX_LEVEL) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        if (seed & 3) break;
+        h++;
+    }
+    return h;
+}
+
+/*
+* Operators
+*/
+template<class T>
+const Set<T>& Set<T>::operator=(Set S) {
+    swap_storage(S);
+    update_index();
+    return *this;
+}
+
+template<class T>
+const Set<T>& Set<T>::operator+=(const Set & S) {
+    if (&S == this) return *this;
+
+    unite(S);
+    update_index();
+    return *this;
+}
+
+template<class T>
+const Set<T>& Set<T>::operator+=(Set && S) {
+    if (&S == this) return *this;
+
+    // Union is commutative, keep the larger arena and merge the smaller set into it
+    if (S.count > count) {
+        swap_storage(S);
+    }
+
+    // Elements of an arena that other sets still share can only be copied
+    if (S.heap.use_count() > 1) {
+        unite(S);
+    } else {
+        unite(std::move(S));
+    }
+
+    // The elements left in S have been moved from
+    S.make_empty();
+    update_index();
     return *this;
 }
 
 template<class T>
 const Set<T>& Set<T>::operator*=(const Set & S) {
-    auto tmpR = head;
-    auto tmpS = S.head;
+    if (&S == this) return *this;
+    SET_STAT(SetStatsTimer timer(counters, OP_INTERSECTION));
+
+    int tmpR = HEAD;
+    int tmpS = S.node(HEAD).next;
 
     /*
     * Loop through this set and remove all elements in this set that is not in S
     */
-    while(tmpR->next != tail) {
-        if (tmpS->next == S.tail) {
+    while(node(tmpR).next != TAIL) {
+        SET_STAT(counters.comparisons[OP_INTERSECTION]++);
+        int nextR = node(tmpR).next;
+        if (tmpS == TAIL) {
             // Reached end of S, remove the rest of the nodes
-            remove_node(tmpR->next);
-        } else if (tmpS->next->data > tmpR->next->data) {
+            remove_node(nextR);
+        } else if (S.node(tmpS).data > node(nextR).data) {
             // Data not found in S, remove node from R
-            remove_node(tmpR->next);
-            // tmpR->next is now pointing to the node after the one that was removed
-        } else if (tmpS->next->data == tmpR->next->data) {
+            remove_node(nextR);
+            // node(tmpR).next is now the node after the one that was removed
+        } else if (S.node(tmpS).data == node(nextR).data) {
             // Data in both sets, keep it. Advance R
-            tmpR = tmpR->next;
+            tmpR = nextR;
         } else {
             // Data not found yet, keep advancing S
-            tmpS = tmpS->next;
+            tmpS = S.node(tmpS).next;
         }
     }
 
+    update_index();
     return *this;
 }
 
 template<class T>
 const Set<T>& Set<T>::operator-=(const Set & S) {
-    auto tmpR = head;
-    auto tmpS = S.head;
+    if (&S == this) {
+        make_empty();
+        return *this;
+    }
+
+    SET_STAT(SetStatsTimer timer(counters, OP_DIFFERENCE));
+
+    int tmpR = HEAD;
+    int tmpS = S.node(HEAD).next;
 
     /*
     * For each element in S, loop through elements in this set until
     * a bigger element is found. If an equal element is found, remove it
     */
-    while(tmpS->next != S.tail && tmpR->next != tail) {
-        if (tmpS->next->data == tmpR->next->data) {
-            remove_node(tmpR->next);
+    while(tmpS != TAIL && node(tmpR).next != TAIL) {
+        SET_STAT(counters.comparisons[OP_DIFFERENCE]++);
+        int nextR = node(tmpR).next;
+        if (S.node(tmpS).data == node(nextR).data) {
+            remove_node(nextR);
             // An element was removed from R, no need to check the same node in S again
-            // tmpR->next is now pointing to the node after the one that was removed
-            tmpS = tmpS->next;
-        } else if (tmpS->next->data > tmpR->next->data) {
+            // node(tmpR).next is now the node after the one that was removed
+            tmpS = S.node(tmpS).next;
+        } else if (S.node(tmpS).data > node(nextR).data) {
             // Advance R
-            tmpR = tmpR->next;
+            tmpR = nextR;
         } else {
             // Advance S
-            tmpS = tmpS->next;
+            tmpS = S.node(tmpS).next;
         }
     }
 
+    update_index();
     return *this;
 }
 
 template<class T>
-bool Set<T>::operator<=(Set& S){
-    auto tmpS = S.head->next;
-    auto tmpR = head->next;
-    if(S._empty() || _empty()) return false;
-    while(tmpS->next != S.tail){
-        if(tmpR->next == tail) return true;
-        if(tmpR->data == tmpS->data){
-            tmpR = tmpR->next;
-            tmpS = tmpS->next;
+bool Set<T>::operator<=(const Set& S) const {
+    SET_STAT(SetStatsTimer timer(counters, OP_COMPARE));
+    if (count > S.count) return false;
+
+    int tmpR = node(HEAD).next;
+    int tmpS = S.node(HEAD).next;
+    int leftR = count, leftS = S.count;
+
+    // Every element of this set has to be found in S, in order
+    while (tmpR != TAIL) {
+        SET_STAT(counters.comparisons[OP_COMPARE]++);
+
+        // Not enough elements left in S for the rest of this set
+        if (leftR > leftS) return false;
+
+        if (S.node(tmpS).data < node(tmpR).data) {
+            tmpS = S.node(tmpS).next;
+            leftS--;
+        } else if (node(tmpR).data < S.node(tmpS).data) {
+            // Element of this set that is not in S
+            return false;
+        } else {
+            tmpR = node(tmpR).next;
+            tmpS = S.node(tmpS).next;
+            leftR--;
+            leftS--;
         }
-        else tmpS = tmpS->next;
     }
-    return false;
+    return true;
 }
 
 template<class T>
-bool Set<T>::operator<(Set& S){
-    if( ( S.cardinality() > cardinality() ) && (*this <= S) ) return true;
-    else return false;
+bool Set<T>::operator<(const Set& S) const {
+    return count < S.count && *this <= S;
 }
 
 template<class T>
-bool Set<T>::operator==(Set& S){
-    if( ( *this <= S ) && ( S <= *this ) )return true;
-    else return false;
+bool Set<T>::operator==(const Set& S) const {
+    SET_STAT(SetStatsTimer timer(counters, OP_COMPARE));
+    if (count != S.count) return false;
+
+    // Same size, so the sets are equal only if the elements match one to one
+    int tmpR = node(HEAD).next;
+    int tmpS = S.node(HEAD).next;
+    while (tmpR != TAIL) {
+        SET_STAT(counters.comparisons[OP_COMPARE]++);
+        if (!(node(tmpR).data == S.node(tmpS).data)) return false;
+        tmpR = node(tmpR).next;
+        tmpS = S.node(tmpS).next;
+    }
+    return true;
 }
 
 template<class T>
-bool Set<T>::operator!=(Set& S){
-    if( *this == S )return false;
-    else return true;
+bool Set<T>::operator!=(const Set& S) const {
+    return !(*this == S);
 }
 #endif // SET_H
-
@@ -0,0 +1,387 @@
+#ifndef SET_EXPR_H
+#define SET_EXPR_H
+
+#include <iostream>
+#include <iterator>
+#include <cstddef>
+#include <type_traits>
+
+using namespace std;
+
+template <class T> class Set;
+template <class T> class SetRange;
+template <class T, template <class, class, class> class C, class L, class R> class SetExpr;
+
+/*
+* Lazy set expressions.
+*
+* A + B, A * B and A - B on sets compute nothing, they return an expression node
+* that refers to its operands. Converting an expression to a Set walks all the sets
+* in it at the same time and appends the result in order, so A + B * C - D is one
+* streaming merge and no temporary sets are built for the partial results.
+*
+* Every expression has a cursor that yields its elements in increasing order:
+*   bool done() const;  const T& value() const;  void next();
+*
+* Named sets are referred to, not copied, so an expression can only be used while the
+* sets it names are alive and unchanged. Temporary sets and values converted to sets,
+* as 4 in A + 4, are kept in the expression, so auto E = A + 4 stays valid.
+* An expression answers the queries and comparisons of a Set, each one walks it again.
+*
+* A range of a set, S.range(lo, hi), is an operand too. A.range(lo, hi) * B is the
+* intersection within [lo, hi), and only the part of A in the range is walked.
+*/
+
+// Leaf of an expression, refers to a set
+template <class T>
+class SetRef {
+public:
+    SetRef(const Set<T>& S) : set(&S) {}
+
+    class cursor {
+    public:
+        cursor(const Set<T>* S) : set(S), n(S->node(Set<T>::HEAD).next) {}
+
+        bool done() const { return n == Set<T>::TAIL; }
+        const T& value() const { return set->node(n).data; }
+        void next() { n = set->node(n).next; }
+
+    private:
+        const Set<T>* set;
+        int n;
+    };
+
+    cursor begin() const { return cursor(set); }
+
+private:
+    const Set<T>* set;
+};
+
+// Leaf of an expression that keeps its set, for temporaries and converted values
+template <class T>
+class SetValue {
+public:
+    SetValue(Set<T> S) : set(std::move(S)) {}
+
+    typedef typename SetRef<T>::cursor cursor;
+    cursor begin() const { return cursor(&set); }
+
+private:
+    Set<T> set;
+};
+
+// Bidirectional iterator over the elements of a set, in increasing order.
+// It stops at the node last, so it is also a cursor over the elements before last
+// and ranges of a set can be operands of expressions
+template <class T>
+class SetIterator {
+public:
+    typedef bidirectional_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const T* pointer;
+    typedef const T& reference;
+
+    SetIterator() : set(nullptr), n(0), last(0) {}
+    SetIterator(const Set<T>* S, int first, int l) : set(S), n(first), last(l) {}
+
+    reference operator*() const { return set->node(n).data; }
+    pointer operator->() const { return &set->node(n).data; }
+
+    SetIterator& operator++() { n = set->node(n).next; return *this; }
+    SetIterator& operator--() { n = set->node(n).prev; return *this; }
+    SetIterator operator++(int) { SetIterator tmp = *this; ++*this; return tmp; }
+    SetIterator operator--(int) { SetIterator tmp = *this; --*this; return tmp; }
+
+    bool operator==(const SetIterator& I) const { return n == I.n && set == I.set; }
+    bool operator!=(const SetIterator& I) const { return !(*this == I); }
+
+    // Cursor
+    bool done() const { return n == last; }
+    const T& value() const { return **this; }
+    void next() { ++*this; }
+
+private:
+    const Set<T>* set;
+    int n;
+    int last;
+};
+
+// Elements in L or in R
+template <class T, class LC, class RC>
+class UnionCursor {
+public:
+    UnionCursor(const LC& l, const RC& r) : L(l), R(r) {}
+
+    bool done() const { return L.done() && R.done(); }
+
+    const T& value() const {
+        if (R.done() || (!L.done() && !(R.value() < L.value()))) return L.value();
+        return R.value();
+    }
+
+    void next() {
+        if (R.done()) {
+            L.next();
+        } else if (L.done()) {
+            R.next();
+        } else if (L.value() < R.value()) {
+            L.next();
+        } else if (R.value() < L.value()) {
+            R.next();
+        } else {
+            // Same element in both, skip it in both
+            L.next();
+            R.next();
+        }
+    }
+
+private:
+    LC L;
+    RC R;
+};
+
+// Elements in both L and R
+template <class T, class LC, class RC>
+class IntersectionCursor {
+public:
+    IntersectionCursor(const LC& l, const RC& r) : L(l), R(r) { settle(); }
+
+    bool done() const { return L.done() || R.done(); }
+    const T& value() const { return L.value(); }
+
+    void next() {
+        L.next();
+        R.next();
+        settle();
+    }
+
+private:
+    // Advance the cursor that is behind until both are at the same element
+    void settle() {
+        while (!L.done() && !R.done()) {
+            if (L.value() < R.value()) L.next();
+            else if (R.value() < L.value()) R.next();
+            else return;
+        }
+    }
+
+    LC L;
+    RC R;
+};
+
+// Elements in L but not in R
+template <class T, class LC, class RC>
+class DifferenceCursor {
+public:
+    DifferenceCursor(const LC& l, const RC& r) : L(l), R(r) { settle(); }
+
+    bool done() const { return L.done(); }
+    const T& value() const { return L.value(); }
+
+    void next() {
+        L.next();
+        settle();
+    }
+
+private:
+    // Skip the elements of L that are also in R
+    void settle() {
+        while (!L.done() && !R.done()) {
+            if (L.value() < R.value()) {
+                return;
+            } else if (R.value() < L.value()) {
+                R.next();
+            } else {
+                L.next();
+                R.next();
+            }
+        }
+    }
+
+    LC L;
+    RC R;
+};
+
+// Operands that a range can be combined with
+template <class T, class X> struct range_operand : false_type {};
+template <class T> struct range_operand<T, Set<T>> : true_type {};
+template <class T> struct range_operand<T, SetRange<T>> : true_type {};
+template <class T, template <class, class, class> class C, class L, class R>
+struct range_operand<T, SetExpr<T, C, L, R>> : true_type {};
+
+// Expression leaf used for each kind of operand
+template <class T, class X> struct leaf_of {};
+template <class T> struct leaf_of<T, Set<T>> { typedef SetRef<T> type; };
+template <class T> struct leaf_of<T, SetRange<T>> { typedef SetRange<T> type; };
+template <class T, template <class, class, class> class C, class L, class R>
+struct leaf_of<T, SetExpr<T, C, L, R>> { typedef SetExpr<T, C, L, R> type; };
+
+template <class T, class X>
+using leaf_t = typename leaf_of<T, X>::type;
+
+// Leaf for an operand passed as X&&. A temporary set and a value converted to a set
+// are kept by SetValue, everything else uses leaf_of
+template <class T, class X, class = void>
+struct operand_of : leaf_of<T, remove_cv_t<remove_reference_t<X>>> {};
+template <class T> struct operand_of<T, Set<T>> { typedef SetValue<T> type; };
+template <class T, class X>
+struct operand_of<T, X, enable_if_t<is_convertible<X, T>::value>> { typedef SetValue<T> type; };
+
+template <class T, class X>
+using operand_t = typename operand_of<T, X>::type;
+
+// A set, or a value that is converted to a set
+template <class T, class X>
+constexpr bool set_operand() {
+    return is_same<remove_cv_t<remove_reference_t<X>>, Set<T>>::value || is_convertible<X, T>::value;
+}
+
+/*
+* Expression node combining L and R with the cursor C.
+* Named sets are held by SetRef, temporary sets, converted values and sub-expressions
+* are held by value.
+*/
+template <class T, template <class, class, class> class C, class L, class R>
+class SetExpr {
+public:
+    typedef C<T, typename L::cursor, typename R::cursor> cursor;
+
+    template <class A, class B>
+    SetExpr(A&& l, B&& r) : left(std::forward<A>(l)), right(std::forward<B>(r)) {}
+
+    cursor begin() const { return cursor(left.begin(), right.begin()); }
+
+    // Expression op set, set op expression, and expression op expression
+    // A set operand can also be a value, as in E + 4
+    template <class X, class = enable_if_t<set_operand<T, X>()>>
+    friend SetExpr<T, UnionCursor, SetExpr, operand_t<T, X>> operator+(const SetExpr& E, X&& S) {
+        return { E, std::forward<X>(S) };
+    }
+    template <class X, class = enable_if_t<set_operand<T, X>()>>
+    friend SetExpr<T, UnionCursor, operand_t<T, X>, SetExpr> operator+(X&& S, const SetExpr& E) {
+        return { std::forward<X>(S), E };
+    }
+    template <template <class, class, class> class C2, class L2, class R2>
+    friend SetExpr<T, UnionCursor, SetExpr, SetExpr<T, C2, L2, R2>>
+    operator+(const SetExpr& E, const SetExpr<T, C2, L2, R2>& F) {
+        return { E, F };
+    }
+
+    template <class X, class = enable_if_t<set_operand<T, X>()>>
+    friend SetExpr<T, IntersectionCursor, SetExpr, operand_t<T, X>> operator*(const SetExpr& E, X&& S) {
+        return { E, std::forward<X>(S) };
+    }
+    template <class X, class = enable_if_t<set_operand<T, X>()>>
+    friend SetExpr<T, IntersectionCursor, operand_t<T, X>, SetExpr> operator*(X&& S, const SetExpr& E) {
+        return { std::forward<X>(S), E };
+    }
+    template <template <class, class, class> class C2, class L2, class R2>
+    friend SetExpr<T, IntersectionCursor, SetExpr, SetExpr<T, C2, L2, R2>>
+    operator*(const SetExpr& E, const SetExpr<T, C2, L2, R2>& F) {
+        return { E, F };
+    }
+
+    template <class X, class = enable_if_t<set_operand<T, X>()>>
+    friend SetExpr<T, DifferenceCursor, SetExpr, operand_t<T, X>> operator-(const SetExpr& E, X&& S) {
+        return { E, std::forward<X>(S) };
+    }
+    template <class X, class = enable_if_t<set_operand<T, X>()>>
+    friend SetExpr<T, DifferenceCursor, operand_t<T, X>, SetExpr> operator-(X&& S, const SetExpr& E) {
+        return { std::forward<X>(S), E };
+    }
+    template <template <class, class, class> class C2, class L2, class R2>
+    friend SetExpr<T, DifferenceCursor, SetExpr, SetExpr<T, C2, L2, R2>>
+    operator-(const SetExpr& E, const SetExpr<T, C2, L2, R2>& F) {
+        return { E, F };
+    }
+
+    // Member functions of Set, without building the result
+    int cardinality() const {
+        int n = 0;
+        for (cursor c = begin(); !c.done(); c.next()) ++n;
+        return n;
+    }
+
+    bool is_member(const T& v) const {
+        for (cursor c = begin(); !c.done() && !(v < c.value()); c.next()) {
+            if (!(c.value() < v)) return true;
+        }
+        return false;
+    }
+
+    bool _empty() const { return begin().done(); }
+
+    // Comparisons and compound operators evaluate the expression to a Set.
+    // S == E, with a set on the left, uses the operators of Set
+    friend bool operator==(const SetExpr& E, const Set<T>& S) { return Set<T>(E) == S; }
+    friend bool operator!=(const SetExpr& E, const Set<T>& S) { return Set<T>(E) != S; }
+    friend bool operator<(const SetExpr& E, const Set<T>& S) { return Set<T>(E) < S; }
+    friend bool operator<=(const SetExpr& E, const Set<T>& S) { return Set<T>(E) <= S; }
+
+    Set<T> operator+=(const Set<T>& S) const { Set<T> V(*this); V += S; return V; }
+    Set<T> operator*=(const Set<T>& S) const { Set<T> V(*this); V *= S; return V; }
+    Set<T> operator-=(const Set<T>& S) const { Set<T> V(*this); V -= S; return V; }
+
+    // Formatted output operator<<, evaluates the expression
+    friend ostream& operator<<(ostream& os, const SetExpr& E) {
+        return os << Set<T>(E);
+    }
+
+private:
+    L left;
+    R right;
+};
+
+/*
+* Elements of a set from first up to, not including, last. Returned by Set::range,
+* Set::lower_bound and Set::upper_bound give the ends.
+* Refers to the set, so it is valid as long as the set is not changed
+*/
+template <class T>
+class SetRange {
+public:
+    typedef SetIterator<T> iterator;
+    typedef SetIterator<T> cursor;
+
+    SetRange(const iterator& f, const iterator& l) : first(f), last(l) {}
+
+    iterator begin() const { return first; }
+    iterator end() const { return last; }
+    bool empty() const { return first == last; }
+
+    // Operators, lazy as the operators of Set
+    // Other operands can be a Set, a range or an expression
+    template <class X, class = enable_if_t<range_operand<T, decay_t<X>>::value>>
+    friend SetExpr<T, UnionCursor, SetRange, operand_t<T, X>> operator+(const SetRange& A, X&& S) {
+        return { A, std::forward<X>(S) };
+    }
+    template <class X, class = enable_if_t<range_operand<T, decay_t<X>>::value && !is_same<decay_t<X>, SetRange>::value>>
+    friend SetExpr<T, UnionCursor, operand_t<T, X>, SetRange> operator+(X&& S, const SetRange& A) {
+        return { std::forward<X>(S), A };
+    }
+
+    template <class X, class = enable_if_t<range_operand<T, decay_t<X>>::value>>
+    friend SetExpr<T, IntersectionCursor, SetRange, operand_t<T, X>> operator*(const SetRange& A, X&& S) {
+        return { A, std::forward<X>(S) };
+    }
+    template <class X, class = enable_if_t<range_operand<T, decay_t<X>>::value && !is_same<decay_t<X>, SetRange>::value>>
+    friend SetExpr<T, IntersectionCursor, operand_t<T, X>, SetRange> operator*(X&& S, const SetRange& A) {
+        return { std::forward<X>(S), A };
+    }
+
+    template <class X, class = enable_if_t<range_operand<T, decay_t<X>>::value>>
+    friend SetExpr<T, DifferenceCursor, SetRange, operand_t<T, X>> operator-(const SetRange& A, X&& S) {
+        return { A, std::forward<X>(S) };
+    }
+    template <class X, class = enable_if_t<range_operand<T, decay_t<X>>::value && !is_same<decay_t<X>, SetRange>::value>>
+    friend SetExpr<T, DifferenceCursor, operand_t<T, X>, SetRange> operator-(X&& S, const SetRange& A) {
+        return { std::forward<X>(S), A };
+    }
+
+private:
+    iterator first;
+    iterator last;
+};
+
+#endif // SET_EXPR_H
@@ -0,0 +1,414 @@
+/*
+  Course: TND004, Lab 1
+  Description: benchmark of the set operations, linked Set vs contiguous FlatSet vs compressed BitmapSet
+  Usage: bench [number of elements]
+  Build with -DSET_STATS to print the operation counters of a set, see set_stats.h
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <fstream>
+#include <cstdio>
+
+#include "Set.h"
+#include "FlatSet.h"
+#include "BitmapSet.h"
+#include "ConcurrentSet.h"
+#include "MappedSet.h"
+#include "simd_merge.h"
+
+using namespace std;
+
+//Elements of the set in the teardown stress run
+const int TEARDOWN_STRESS = 10000000;
+
+//Time in milliseconds to run f
+template <class F>
+double time_ms(F f)
+{
+    auto start = chrono::steady_clock::now();
+    f();
+    auto stop = chrono::steady_clock::now();
+
+    return chrono::duration<double, milli>(stop - start).count();
+}
+
+struct Timings
+{
+    double copy, _union, intersection, difference;
+    int check;      //sum of the result sizes, the same for every implementation
+};
+
+//Stop the benchmark if an implementation gives another result than the reference
+void verify(const string& what, long long got, long long expected)
+{
+    if (got != expected)
+    {
+        cout << "MISMATCH in " << what << ": " << got << ", expected " << expected << endl;
+        exit(1);
+    }
+}
+
+//Run every operation on sets A = {0, 2, 4, ...} and B = {0, 3, 6, ...}
+template <template <class> class S>
+Timings run(vector<int>& a, vector<int>& b)
+{
+    Timings t;
+    S<int> A(a.data(), (int)a.size());
+    S<int> B(b.data(), (int)b.size());
+    S<int> one(-1);
+    int check = 0;
+
+    //A Set copy shares the nodes of A until it changes, adding one element makes it copy them
+    t.copy = time_ms([&]() { S<int> C(A); C += one; check += C.cardinality(); });
+    t._union = time_ms([&]() { S<int> C(A); C += B; check += C.cardinality(); });
+    t.intersection = time_ms([&]() { S<int> C(A); C *= B; check += C.cardinality(); });
+    t.difference = time_ms([&]() { S<int> C(A); C -= B; check += C.cardinality(); });
+
+    cout << "  (check " << check << ")" << endl;
+    t.check = check;
+
+    return t;
+}
+
+void report(const string& op, double list, double flat)
+{
+    cout << setw(14) << op << ": "
+         << setw(10) << fixed << setprecision(2) << list << " ms"
+         << setw(10) << flat << " ms"
+         << setw(8) << setprecision(1) << list / flat << "x" << endl;
+}
+
+//Sorted set of about n random ids in [0, 4n)
+vector<int> random_ids(int n, unsigned seed)
+{
+    mt19937 rng(seed);
+    vector<int> v;
+
+    for (int i = 0; i < n; ++i)
+    {
+        v.push_back((int)(rng() % (4u * n)));
+    }
+    sort(v.begin(), v.end());
+    v.erase(unique(v.begin(), v.end()), v.end());
+
+    return v;
+}
+
+//Intersection and difference kernels of FlatSet<int> on each instruction set
+//Random ids, the regular sets above are too easy for the branch predictor
+void run_kernels(int n)
+{
+    vector<int> a = random_ids(n, 1);
+    vector<int> b = random_ids(n, 2);
+    const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE4, SimdLevel::AVX2 };
+    const char* names[] = { "scalar", "sse4", "avx2" };
+    vector<int> out(a.size());
+    double base_i = 0, base_d = 0;
+
+    Set<int> LA = Set<int>::from_range(a);
+    Set<int> LB = Set<int>::from_range(b);
+    int ref_i = Set<int>(LA * LB).cardinality();
+    int ref_d = Set<int>(LA - LB).cardinality();
+
+    cout << endl << setw(14) << "kernel" << ": "
+         << setw(13) << "intersection" << setw(13) << "difference" << endl;
+
+    for (int k = 0; k < 3; ++k)
+    {
+        if (levels[k] > simd_level()) break;
+
+        size_t ni = 0, nd = 0;
+        double ti = time_ms([&]() { ni = intersect_sorted(a.data(), a.size(), b.data(), b.size(), out.data(), levels[k]); });
+        double td = time_ms([&]() { nd = difference_sorted(a.data(), a.size(), b.data(), b.size(), out.data(), levels[k]); });
+
+        verify(string(names[k]) + " intersection", (long long)ni, ref_i);
+        verify(string(names[k]) + " difference", (long long)nd, ref_d);
+
+        if (k == 0)
+        {
+            base_i = ti;
+            base_d = td;
+        }
+
+        cout << setw(14) << names[k] << ": "
+             << setw(10) << fixed << setprecision(2) << ti << " ms"
+             << setw(10) << td << " ms"
+             << "  (" << setprecision(1) << base_i / ti << "x, " << base_d / td << "x)"
+             << "  (check " << ni + nd << ")" << endl;
+    }
+}
+
+//Build a FlatSet from n unsorted ids with duplicates, on 1, 2, 4, ... threads
+void run_bulk_build(int n)
+{
+    mt19937 rng(3);
+    vector<int> ids(n);
+    for (int& x : ids)
+    {
+        x = (int)(rng() % (unsigned)n);
+    }
+
+    unsigned hw = max(thread::hardware_concurrency(), 1u);
+    double base = 0;
+
+    vector<int> sorted(ids);
+    sort(sorted.begin(), sorted.end());
+    int ref = Set<int>::from_range(sorted).cardinality();
+
+    cout << endl << setw(14) << "bulk build" << ": " << n << " unsorted ids" << endl;
+
+    for (unsigned threads = 1; threads <= hw; threads *= 2)
+    {
+        int size = 0;
+        double t = time_ms([&]() { size = FlatSet<int>(ids.begin(), ids.end(), threads).cardinality(); });
+
+        verify("bulk build on " + to_string(threads) + " threads", size, ref);
+
+        if (threads == 1) base = t;
+
+        cout << setw(11) << threads << " th: "
+             << setw(10) << fixed << setprecision(2) << t << " ms"
+             << setw(8) << setprecision(1) << base / t << "x"
+             << "  (check " << size << ")" << endl;
+    }
+}
+
+//Union and intersection of two FlatSets of n random ids, on 1, 2, 4, ... threads
+void run_parallel_merge(int n)
+{
+    vector<int> a = random_ids(n, 4);
+    vector<int> b = random_ids(n, 5);
+    FlatSet<int> A = FlatSet<int>::from_range(a);
+    FlatSet<int> B = FlatSet<int>::from_range(b);
+
+    Set<int> LA = Set<int>::from_range(a);
+    Set<int> LB = Set<int>::from_range(b);
+    int ref_u = Set<int>(LA + LB).cardinality();
+    int ref_i = Set<int>(LA * LB).cardinality();
+
+    unsigned hw = max(thread::hardware_concurrency(), 1u);
+    size_t threshold = FlatSet<int>::parallel_threshold;
+    unsigned threads = FlatSet<int>::parallel_threads;
+    double base_u = 0, base_i = 0;
+
+    FlatSet<int>::parallel_threshold = 0;
+
+    cout << endl << setw(14) << "partitioned" << ": "
+         << setw(13) << "union" << setw(13) << "intersection" << endl;
+
+    for (unsigned th = 1; th <= hw; th *= 2)
+    {
+        FlatSet<int>::parallel_threads = th;
+
+        int nu = 0, ni = 0;
+        double tu = time_ms([&]() { FlatSet<int> C(A); C += B; nu = C.cardinality(); });
+        double ti = time_ms([&]() { FlatSet<int> C(A); C *= B; ni = C.cardinality(); });
+
+        verify("partitioned union on " + to_string(th) + " threads", nu, ref_u);
+        verify("partitioned intersection on " + to_string(th) + " threads", ni, ref_i);
+
+        if (th == 1)
+        {
+            base_u = tu;
+            base_i = ti;
+        }
+
+        cout << setw(11) << th << " th: "
+             << setw(10) << fixed << setprecision(2) << tu << " ms"
+             << setw(10) << ti << " ms"
+             << "  (" << setprecision(1) << base_u / tu << "x, " << base_i / ti << "x)" << endl;
+    }
+
+    FlatSet<int>::parallel_threshold = threshold;
+    FlatSet<int>::parallel_threads = threads;
+}
+
+//Destroy a set of n elements, and empty another one with make_empty
+//The nodes are released in bulk with the arena, the stack does not grow with n
+void run_teardown(int n)
+{
+    vector<int> ids(n);
+    for (int i = 0; i < n; ++i)
+    {
+        ids[i] = i;
+    }
+
+    Set<int>* S = new Set<int>(ids.data(), n);
+    double destroy = time_ms([&]() { delete S; });
+
+    Set<int> E(ids.data(), n);
+    double empty = time_ms([&]() { E.make_empty(); });
+
+    cout << endl << setw(14) << "teardown" << ": " << n << " elements" << endl;
+    cout << setw(14) << "destructor" << ": " << setw(10) << fixed << setprecision(2) << destroy << " ms" << endl;
+    cout << setw(14) << "make_empty" << ": " << setw(10) << empty << " ms" << endl;
+}
+
+//Insert n random ids from 1, 2, 4, ... threads, into an indexed Set behind one mutex
+//and into a ConcurrentSet
+void run_concurrent_insert(int n)
+{
+    vector<int> ids = random_ids(n, 6);
+    shuffle(ids.begin(), ids.end(), mt19937(7));
+
+    unsigned hw = max(thread::hardware_concurrency(), 1u);
+
+    cout << endl << setw(14) << "concurrent" << ": "
+         << setw(13) << "one mutex" << setw(13) << "sharded" << endl;
+
+    for (unsigned th = 1; th <= hw; th *= 2)
+    {
+        //Thread t inserts ids[t], ids[t + th], ...
+        auto insert_all = [&](auto insert)
+        {
+            vector<thread> pool;
+            for (unsigned t = 0; t < th; ++t)
+            {
+                pool.emplace_back([&, t]()
+                {
+                    for (size_t i = t; i < ids.size(); i += th) insert(ids[i]);
+                });
+            }
+            for (thread& t : pool) t.join();
+        };
+
+        Set<int> S;
+        S.use_index();
+        mutex lock;
+        double tm = time_ms([&]() { insert_all([&](int v) { lock_guard<mutex> g(lock); S.insert(v); }); });
+
+        ConcurrentSet<int> C;
+        double tc = time_ms([&]() { insert_all([&](int v) { C.insert(v); }); });
+
+        cout << setw(11) << th << " th: "
+             << setw(10) << fixed << setprecision(2) << tm << " ms"
+             << setw(10) << tc << " ms"
+             << setw(8) << setprecision(1) << tm / tc << "x"
+             << "  (check " << S.cardinality() + C.snapshot().cardinality() << ")" << endl;
+    }
+}
+
+//Save a set of n random ids, plain and delta encoded, then map it and intersect it with another set
+void run_mapped(int n)
+{
+    Set<int> A = Set<int>::from_range(random_ids(n, 8));
+    Set<int> B = Set<int>::from_range(random_ids(n, 9));
+    const char* names[] = { "plain", "delta" };
+
+    cout << endl << setw(14) << "mapped" << ": "
+         << setw(13) << "save" << setw(13) << "open" << setw(13) << "intersect" << setw(12) << "bytes" << endl;
+
+    for (int delta = 0; delta < 2; ++delta)
+    {
+        string path = string("bench_") + names[delta] + ".set";
+        double ts = time_ms([&]() { A.save(path, delta == 1); });
+
+        MappedSet<int>* M = nullptr;
+        double to = time_ms([&]() { M = new MappedSet<int>(path); });
+
+        int size = 0;
+        double ti = time_ms([&]() { size = Set<int>(*M * B).cardinality(); });
+
+        ifstream file(path, ios::binary | ios::ate);
+        cout << setw(14) << names[delta] << ": "
+             << setw(10) << fixed << setprecision(2) << ts << " ms"
+             << setw(10) << to << " ms"
+             << setw(10) << ti << " ms"
+             << setw(12) << (long long)file.tellg()
+             << "  (check " << size << ")" << endl;
+
+        delete M;
+        remove(path.c_str());
+    }
+}
+
+//Intersect within a window of a tenth of the values, whole sets then filtered vs ranges of the sets
+void run_range(int n)
+{
+    Set<int> A = Set<int>::from_range(random_ids(n, 10));
+    Set<int> B = Set<int>::from_range(random_ids(n, 11));
+    A.use_index();
+    B.use_index();
+    int lo = 2 * n, hi = lo + (4 * n) / 10;
+    int check = 0;
+
+    double tf = time_ms([&]() {
+        Set<int> C = A * B;
+        for (int v : C) check += (lo <= v && v < hi);
+    });
+    double tr = time_ms([&]() { check += Set<int>(A.range(lo, hi) * B.range(lo, hi)).cardinality(); });
+
+    cout << endl << setw(14) << "range" << ": "
+         << setw(13) << "filtered" << setw(13) << "ranges" << endl;
+    report("intersection", tf, tr);
+    cout << "  (check " << check << ")" << endl;
+
+#ifdef SET_STATS
+    cout << setw(14) << "stats of A" << ": ";
+    A.stats().write_json(cout);
+    cout << endl;
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+    int n = (argc > 1) ? atoi(argv[1]) : 100000;
+
+    vector<int> a, b;
+    for (int i = 0; i < n; ++i)
+    {
+        a.push_back(2 * i);
+        b.push_back(3 * i);
+    }
+
+    cout << "Elements per set: " << n << endl;
+
+    cout << "Set (linked nodes)" << endl;
+    Timings list = run<Set>(a, b);
+
+    cout << "FlatSet (contiguous)" << endl;
+    Timings flat = run<FlatSet>(a, b);
+    verify("FlatSet", flat.check, list.check);
+
+    cout << endl << setw(14) << "operation" << ": "
+         << setw(13) << "Set" << setw(13) << "FlatSet" << setw(9) << "speedup" << endl;
+
+    report("copy", list.copy, flat.copy);
+    report("union", list._union, flat._union);
+    report("intersection", list.intersection, flat.intersection);
+    report("difference", list.difference, flat.difference);
+
+    cout << "BitmapSet (compressed chunks)" << endl;
+    Timings bits = run<BitmapSet>(a, b);
+    verify("BitmapSet", bits.check, list.check);
+
+    cout << endl << setw(14) << "operation" << ": "
+         << setw(13) << "FlatSet" << setw(13) << "BitmapSet" << setw(9) << "speedup" << endl;
+
+    report("copy", flat.copy, bits.copy);
+    report("union", flat._union, bits._union);
+    report("intersection", flat.intersection, bits.intersection);
+    report("difference", flat.difference, bits.difference);
+
+    run_kernels(n);
+    run_bulk_build(n);
+    run_parallel_merge(n);
+    run_concurrent_insert(n);
+    run_mapped(n);
+    run_range(n);
+    run_teardown(n);
+
+    //Stress run, a chain this long overflowed the stack when it was released recursively
+    if (n < TEARDOWN_STRESS) run_teardown(TEARDOWN_STRESS);
+
+    return 0;
+}
@@ -0,0 +1,83 @@
+#ifndef PARALLEL_SORT_H
+#define PARALLEL_SORT_H
+
+#include <vector>
+#include <algorithm>
+#include <thread>
+
+using namespace std;
+
+// Inputs smaller than this per thread are not worth a thread of their own
+const size_t MIN_PARALLEL_CHUNK = 1 << 15;
+
+/*
+* Sorts v and removes duplicates, using up to threads threads.
+* v is cut in one chunk per thread. Each chunk is sorted and deduplicated on its
+* own thread, then neighbouring chunks are merged pairwise, also in parallel,
+* until one run is left.
+*/
+template <class T>
+void parallel_sort_unique(vector<T>& v, unsigned threads = thread::hardware_concurrency())
+{
+    size_t chunks = min<size_t>(max(threads, 1u), v.size() / MIN_PARALLEL_CHUNK);
+
+    if (chunks < 2) {
+        sort(v.begin(), v.end());
+        v.erase(unique(v.begin(), v.end()), v.end());
+        return;
+    }
+
+    // Run c is v[bound[c], bound[c+1])
+    vector<size_t> bound(chunks + 1);
+    vector<size_t> ends(chunks);
+    for (size_t c = 0; c <= chunks; ++c) {
+        bound[c] = v.size() * c / chunks;
+    }
+
+    vector<thread> pool;
+    for (size_t c = 0; c < chunks; ++c) {
+        pool.emplace_back([&v, &bound, &ends, c]() {
+            auto first = v.begin() + bound[c];
+            auto last = v.begin() + bound[c + 1];
+            sort(first, last);
+            ends[c] = unique(first, last) - v.begin();
+        });
+    }
+    for (thread& t : pool) t.join();
+
+    // Close the gaps left by the duplicates
+    size_t w = ends[0];
+    for (size_t c = 1; c < chunks; ++c) {
+        size_t start = w;
+        w = move(v.begin() + bound[c], v.begin() + ends[c], v.begin() + w) - v.begin();
+        bound[c] = start;
+    }
+    bound[chunks] = w;
+    v.erase(v.begin() + w, v.end());
+
+    // Merge runs two by two, halving the number of runs each round
+    while (bound.size() > 2) {
+        vector<size_t> next;
+        pool.clear();
+
+        size_t c = 0;
+        for (; c + 2 < bound.size(); c += 2) {
+            size_t lo = bound[c], mid = bound[c + 1], hi = bound[c + 2];
+            pool.emplace_back([&v, lo, mid, hi]() {
+                inplace_merge(v.begin() + lo, v.begin() + mid, v.begin() + hi);
+            });
+            next.push_back(lo);
+        }
+        // An odd run out waits for the next round
+        if (c + 2 == bound.size()) next.push_back(bound[c]);
+        next.push_back(v.size());
+
+        for (thread& t : pool) t.join();
+        bound.swap(next);
+    }
+
+    // Duplicates across chunks are now next to each other
+    v.erase(unique(v.begin(), v.end()), v.end());
+}
+
+#endif // PARALLEL_SORT_H
@@ -0,0 +1,157 @@
+#ifndef SET_FILE_H
+#define SET_FILE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <type_traits>
+
+using namespace std;
+
+/*
+* Binary file format of a set of trivially copyable elements, written by Set<T>::save
+* and read in place by MappedSet<T>.
+*
+* The file starts with a SetFileHeader. The elements follow in increasing order, either
+*   plain - count elements of type T, as they are in memory
+*   delta - for integral T only. The elements are cut in blocks of DELTA_BLOCK elements.
+*           A table with the first element of each block and where the rest of the block
+*           starts comes first, then the differences between consecutive elements of every
+*           block, as LEB128 varints. A lookup binary searches the table, then decodes one block
+*
+* Numbers are stored in the byte order of the machine that wrote the file.
+*/
+
+const char SET_FILE_MAGIC[4] = { 'S', 'E', 'T', 'B' };
+const uint32_t SET_FILE_VERSION = 1;
+const uint32_t SET_FILE_DELTA = 1;     // flag, the elements are delta encoded
+const size_t DELTA_BLOCK = 128;
+
+struct SetFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t elem_size;     // sizeof(T) of the writer
+    uint32_t flags;
+    uint64_t count;         // number of elements
+    uint64_t blocks;        // entries in the block table, delta files only
+};
+
+// Entry of the block table
+template <class T>
+struct DeltaBlock
+{
+    uint64_t offset;        // start of the block's differences, from the start of the varints
+    T first;
+};
+
+// Appends x to out, seven bits per byte, the high bit is set on all bytes but the last
+inline void put_varint(vector<uint8_t>& out, uint64_t x)
+{
+    while (x >= 0x80) {
+        out.push_back((uint8_t)(x | 0x80));
+        x >>= 7;
+    }
+    out.push_back((uint8_t)x);
+}
+
+// Reads the varint at p into x and advances p past it. A 64-bit number takes at most
+// MAX_VARINT bytes, returns false for a longer varint, the file is not a valid set file
+const int MAX_VARINT = 10;
+
+inline bool get_varint(const uint8_t*& p, uint64_t& x)
+{
+    x = 0;
+    for (int k = 0; k < MAX_VARINT; ++k) {
+        uint8_t b = *p++;
+        x |= (uint64_t)(b & 0x7F) << (7 * k);
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+// Difference b - a of two integers with a <= b, as an unsigned number
+template <class T>
+uint64_t delta_of(T a, T b)
+{
+    typedef make_unsigned_t<T> U;
+    return (uint64_t)(U)((U)b - (U)a);
+}
+
+template <class T>
+T add_delta(T a, uint64_t d)
+{
+    typedef make_unsigned_t<T> U;
+    return (T)(U)((U)a + (U)d);
+}
+
+/*
+* Writes count elements to a set file, the cursor yields them in increasing order.
+* Returns false when the file could not be written
+*/
+template <class T, class Cursor>
+bool write_set_file(const string& path, Cursor c, size_t count, bool delta)
+{
+    static_assert(is_trivially_copyable<T>::value, "only trivially copyable elements can be saved");
+    static_assert(alignof(T) <= 8, "elements are aligned to 8 bytes in the file");
+
+    SetFileHeader h;
+    memcpy(h.magic, SET_FILE_MAGIC, 4);
+    h.version = SET_FILE_VERSION;
+    h.elem_size = sizeof(T);
+    h.flags = 0;
+    h.count = count;
+    h.blocks = 0;
+
+    ofstream file(path, ios::binary);
+    if (!file) return false;
+
+    if constexpr (is_integral<T>::value) {
+        if (delta) {
+            vector<DeltaBlock<T>> table;
+            vector<uint8_t> bytes;
+            T prev{};
+
+            for (size_t i = 0; !c.done(); c.next(), ++i) {
+                T x = c.value();
+                if (i % DELTA_BLOCK == 0) {
+                    DeltaBlock<T> b;
+                    memset(&b, 0, sizeof(b));
+                    b.offset = bytes.size();
+                    b.first = x;
+                    table.push_back(b);
+                } else {
+                    put_varint(bytes, delta_of(prev, x));
+                }
+                prev = x;
+            }
+
+            h.flags = SET_FILE_DELTA;
+            h.blocks = table.size();
+            file.write((const char*)&h, sizeof(h));
+            file.write((const char*)table.data(), table.size() * sizeof(DeltaBlock<T>));
+            file.write((const char*)bytes.data(), bytes.size());
+            return (bool)file;
+        }
+    }
+
+    file.write((const char*)&h, sizeof(h));
+
+    // Written a buffer at a time
+    vector<T> buffer;
+    buffer.reserve(4096);
+    for (; !c.done(); c.next()) {
+        buffer.push_back(c.value());
+        if (buffer.size() == 4096) {
+            file.write((const char*)buffer.data(), buffer.size() * sizeof(T));
+            buffer.clear();
+        }
+    }
+    file.write((const char*)buffer.data(), buffer.size() * sizeof(T));
+    return (bool)file;
+}
+
+#endif // SET_FILE_H
@@ -0,0 +1,96 @@
+#ifndef SET_STATS_H
+#define SET_STATS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+
+/*
+* Operation counters of a Set.
+*
+* Off unless SET_STATS is defined, e.g. with -DSET_STATS. Without it SET_STAT(...) expands
+* to nothing, the set has no counters and no clocks are read, and Set::stats() only reports
+* the bytes resident.
+*
+* With it every set counts
+*   - nodes taken from its arena and nodes given back
+*   - for each operation the calls, the element comparisons and the time spent
+* Comparisons are counted per step of the loops in Set, the merges of lazy expressions are
+* counted as one evaluation of the set they are converted to.
+*
+* The counters are plain numbers, const member functions of Set count in them too. A build
+* with SET_STATS is for one thread per set, even the lookups on a const set must not run
+* at the same time.
+*/
+
+#ifdef SET_STATS
+#define SET_STAT(...) __VA_ARGS__
+#else
+#define SET_STAT(...)
+#endif
+
+enum SetOp {
+    OP_IS_MEMBER, OP_INSERT, OP_REMOVE, OP_SEARCH, OP_CONTAINS_MANY,
+    OP_UNION, OP_INTERSECTION, OP_DIFFERENCE, OP_COMPARE, OP_EVALUATE,
+    OP_COUNT
+};
+
+const char* const SET_OP_NAMES[OP_COUNT] = {
+    "is_member", "insert", "remove", "search", "contains_many",
+    "union", "intersection", "difference", "compare", "evaluate"
+};
+
+struct SetStats
+{
+    bool enabled = false;           // false when built without SET_STATS, only bytes_resident is set
+    uint64_t nodes_allocated = 0;
+    uint64_t nodes_freed = 0;
+    size_t bytes_resident = 0;      // the set, its arena and its index. A shared arena is counted in full
+
+    uint64_t calls[OP_COUNT] = {};
+    uint64_t comparisons[OP_COUNT] = {};
+    uint64_t time_ns[OP_COUNT] = {};
+
+    // One JSON object, operations that were never called are left out
+    void write_json(ostream& os) const {
+        os << "{\"enabled\": " << (enabled ? "true" : "false")
+           << ", \"nodes_allocated\": " << nodes_allocated
+           << ", \"nodes_freed\": " << nodes_freed
+           << ", \"bytes_resident\": " << bytes_resident
+           << ", \"ops\": {";
+
+        const char* sep = "";
+        for (int op = 0; op < OP_COUNT; ++op) {
+            if (calls[op] == 0) continue;
+            os << sep << "\"" << SET_OP_NAMES[op] << "\": {\"calls\": " << calls[op]
+               << ", \"comparisons\": " << comparisons[op]
+               << ", \"time_ns\": " << time_ns[op] << "}";
+            sep = ", ";
+        }
+        os << "}}";
+    }
+};
+
+// Counts a call of op, and adds the time until the end of the scope
+class SetStatsTimer
+{
+public:
+    SetStatsTimer(SetStats& s, SetOp o) : stats(s), op(o), start(chrono::steady_clock::now()) {
+        stats.calls[op]++;
+    }
+
+    ~SetStatsTimer() {
+        auto t = chrono::steady_clock::now() - start;
+        stats.time_ns[op] += (uint64_t)chrono::duration_cast<chrono::nanoseconds>(t).count();
+    }
+
+private:
+    SetStats& stats;
+    SetOp op;
+    chrono::steady_clock::time_point start;
+};
+
+#endif // SET_STATS_H
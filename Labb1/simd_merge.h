@@ -0,0 +1,257 @@
+#ifndef SIMD_MERGE_H
+#define SIMD_MERGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMD_MERGE_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+/*
+* Intersection and difference kernels for sorted, duplicate free arrays
+* of 32-bit integers (int, unsigned, ...).
+*
+* Every function writes its result to out and returns the number of elements
+* written. out must have room for na elements, and may be the same array as a:
+* elements are never written ahead of the block that is being read.
+*
+* The vector kernels compare a block of a against a block of b, all pairs at once,
+* and remember which elements of the a-block were found. The block with the smallest
+* last element is then replaced by the next one. An a-block is only emitted when it is
+* replaced, at that point every element of b that could match it has been seen.
+*/
+
+// Instruction sets a kernel can use, picked at runtime
+enum class SimdLevel { Scalar, SSE4, AVX2 };
+
+template <class U>
+size_t intersect_scalar(const U* a, size_t na, const U* b, size_t nb, U* out,
+                        size_t i = 0, size_t j = 0, size_t w = 0)
+{
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            i++;
+        } else if (b[j] < a[i]) {
+            j++;
+        } else {
+            out[w++] = a[i];
+            i++; j++;
+        }
+    }
+    return w;
+}
+
+template <class U>
+size_t difference_scalar(const U* a, size_t na, const U* b, size_t nb, U* out,
+                         size_t i = 0, size_t j = 0, size_t w = 0)
+{
+    while (i < na && j < nb) {
+        if (a[i] < b[j]) {
+            out[w++] = a[i++];
+        } else if (b[j] < a[i]) {
+            j++;
+        } else {
+            i++; j++;
+        }
+    }
+    // Everything after the end of b is kept
+    while (i < na) {
+        out[w++] = a[i++];
+    }
+    return w;
+}
+
+#ifdef SIMD_MERGE_X86
+
+// Lane permutations that move the lanes set in a mask to the front, one per mask
+template <int BLOCK>
+struct CompressTable {
+    int lanes[1 << BLOCK][BLOCK];
+
+    CompressTable() {
+        for (int m = 0; m < (1 << BLOCK); ++m) {
+            int n = 0;
+            for (int k = 0; k < BLOCK; ++k) {
+                if (m & (1 << k)) lanes[m][n++] = k;
+            }
+            while (n < BLOCK) lanes[m][n++] = 0;
+        }
+    }
+};
+
+template <int BLOCK>
+const CompressTable<BLOCK>& compress_table()
+{
+    static const CompressTable<BLOCK> table;
+    return table;
+}
+
+// b can be ahead of a when the loop stops, step back to the first element that could still match a[i]
+template <class U>
+inline size_t rewind(const U* a, size_t i, const U* b, size_t j)
+{
+    while (j > 0 && !(b[j - 1] < a[i])) {
+        j--;
+    }
+    return j;
+}
+
+template <class U>
+__attribute__((target("sse4.1")))
+size_t merge_sse4(const U* a, size_t na, const U* b, size_t nb, U* out, unsigned keep)
+{
+    size_t i = 0, j = 0, w = 0;
+
+    if (na >= 4 && nb >= 4) {
+        __m128i va = _mm_loadu_si128((const __m128i*)a);
+        __m128i vb = _mm_loadu_si128((const __m128i*)b);
+        unsigned mask = 0;
+
+        // pshufb masks built from the lane permutations
+        alignas(16) static uint8_t shuffle[16][16];
+        static const bool ready = [](){
+            const CompressTable<4>& t = compress_table<4>();
+            for (int m = 0; m < 16; ++m)
+                for (int k = 0; k < 16; ++k)
+                    shuffle[m][k] = (uint8_t)(4 * t.lanes[m][k / 4] + k % 4);
+            return true;
+        }();
+        (void)ready;
+
+        while (true) {
+            // Compare va with the four rotations of vb
+            __m128i c0 = _mm_cmpeq_epi32(va, vb);
+            __m128i c1 = _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)));
+            __m128i c2 = _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2)));
+            __m128i c3 = _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)));
+            __m128i c = _mm_or_si128(_mm_or_si128(c0, c1), _mm_or_si128(c2, c3));
+            mask |= (unsigned)_mm_movemask_ps(_mm_castsi128_ps(c));
+
+            U amax = a[i + 3], bmax = b[j + 3];
+
+            if (!(bmax < amax)) {
+                // Pack the kept lanes to the front and store the whole block,
+                // the lanes after them are overwritten by the next store
+                unsigned m = keep ? mask : (~mask & 0xFu);
+                __m128i packed = _mm_shuffle_epi8(va, _mm_load_si128((const __m128i*)shuffle[m]));
+                _mm_storeu_si128((__m128i*)(out + w), packed);
+                w += (size_t)__builtin_popcount(m);
+                mask = 0;
+                i += 4;
+                if (i + 4 > na) {
+                    if (!(amax < bmax)) j += 4;
+                    break;
+                }
+                va = _mm_loadu_si128((const __m128i*)(a + i));
+            }
+            if (!(amax < bmax)) {
+                j += 4;
+                if (j + 4 > nb) break;
+                vb = _mm_loadu_si128((const __m128i*)(b + j));
+            }
+        }
+        if (i < na) j = rewind(a, i, b, j);
+    }
+
+    return keep ? intersect_scalar(a, na, b, nb, out, i, j, w)
+                : difference_scalar(a, na, b, nb, out, i, j, w);
+}
+
+template <class U>
+__attribute__((target("avx2")))
+size_t merge_avx2(const U* a, size_t na, const U* b, size_t nb, U* out, unsigned keep)
+{
+    size_t i = 0, j = 0, w = 0;
+
+    if (na >= 8 && nb >= 8) {
+        __m256i va = _mm256_loadu_si256((const __m256i*)a);
+        __m256i vb = _mm256_loadu_si256((const __m256i*)b);
+        const __m256i rot = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+        const CompressTable<8>& table = compress_table<8>();
+        unsigned mask = 0;
+
+        while (true) {
+            // Compare va with the eight rotations of vb
+            __m256i r = vb;
+            __m256i c = _mm256_cmpeq_epi32(va, r);
+            for (int k = 1; k < 8; ++k) {
+                r = _mm256_permutevar8x32_epi32(r, rot);
+                c = _mm256_or_si256(c, _mm256_cmpeq_epi32(va, r));
+            }
+            mask |= (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(c));
+
+            U amax = a[i + 7], bmax = b[j + 7];
+
+            if (!(bmax < amax)) {
+                unsigned m = keep ? mask : (~mask & 0xFFu);
+                __m256i perm = _mm256_loadu_si256((const __m256i*)table.lanes[m]);
+                _mm256_storeu_si256((__m256i*)(out + w), _mm256_permutevar8x32_epi32(va, perm));
+                w += (size_t)__builtin_popcount(m);
+                mask = 0;
+                i += 8;
+                if (i + 8 > na) {
+                    if (!(amax < bmax)) j += 8;
+                    break;
+                }
+                va = _mm256_loadu_si256((const __m256i*)(a + i));
+            }
+            if (!(amax < bmax)) {
+                j += 8;
+                if (j + 8 > nb) break;
+                vb = _mm256_loadu_si256((const __m256i*)(b + j));
+            }
+        }
+        if (i < na) j = rewind(a, i, b, j);
+    }
+
+    return keep ? intersect_scalar(a, na, b, nb, out, i, j, w)
+                : difference_scalar(a, na, b, nb, out, i, j, w);
+}
+
+#endif // SIMD_MERGE_X86
+
+// Best instruction set supported by this CPU, detected once
+inline SimdLevel simd_level()
+{
+#ifdef SIMD_MERGE_X86
+    static const SimdLevel level =
+        __builtin_cpu_supports("avx2") ? SimdLevel::AVX2 :
+        __builtin_cpu_supports("sse4.1") ? SimdLevel::SSE4 : SimdLevel::Scalar;
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+// Intersection of a and b, using the given instruction set
+template <class U>
+size_t intersect_sorted(const U* a, size_t na, const U* b, size_t nb, U* out,
+                        SimdLevel level = simd_level())
+{
+    static_assert(is_integral<U>::value && sizeof(U) == 4, "32-bit integers only");
+#ifdef SIMD_MERGE_X86
+    if (level == SimdLevel::AVX2) return merge_avx2(a, na, b, nb, out, 1u);
+    if (level == SimdLevel::SSE4) return merge_sse4(a, na, b, nb, out, 1u);
+#endif
+    return intersect_scalar(a, na, b, nb, out);
+}
+
+// Difference a - b, using the given instruction set
+template <class U>
+size_t difference_sorted(const U* a, size_t na, const U* b, size_t nb, U* out,
+                         SimdLevel level = simd_level())
+{
+    static_assert(is_integral<U>::value && sizeof(U) == 4, "32-bit integers only");
+#ifdef SIMD_MERGE_X86
+    if (level == SimdLevel::AVX2) return merge_avx2(a, na, b, nb, out, 0u);
+    if (level == SimdLevel::SSE4) return merge_sse4(a, na, b, nb, out, 0u);
+#endif
+    return difference_scalar(a, na, b, nb, out);
+}
+
+#endif // SIMD_MERGE_H
@@ -0,0 +1,555 @@
+/*
+  Course: TND004, Lab 1
+  Description: test program for Set, FlatSet and BitmapSet, edge cases of the merge kernels
+  Every result is compared with the result of std::set_union, std::set_intersection
+  and std::set_difference on the same elements, or with a std::set. Returns 1 if a test fails
+*/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <set>
+
+#include "Set.h"
+#include "FlatSet.h"
+#include "BitmapSet.h"
+#include "simd_merge.h"
+
+using namespace std;
+
+int failed = 0;
+
+//Deterministic pseudo-random numbers, the same on every run
+unsigned next_rand(unsigned& seed)
+{
+    seed = seed * 1103515245u + 12345u;
+    return seed >> 8;
+}
+
+//Sorted, duplicate free vector of at most n values in [lo, lo + range)
+vector<int> make_ids(int n, int lo, int range, unsigned seed)
+{
+    vector<int> v;
+    for (int i = 0; i < n; ++i)
+    {
+        v.push_back(lo + (int)(next_rand(seed) % (unsigned)range));
+    }
+    sort(v.begin(), v.end());
+    v.erase(unique(v.begin(), v.end()), v.end());
+
+    return v;
+}
+
+void expect(bool ok, const string& what)
+{
+    if (!ok)
+    {
+        cout << "FAILED: " << what << endl;
+        failed++;
+    }
+}
+
+//Union, intersection and difference of a and b, compound and binary operators, both orders
+template <template <class> class S>
+void check_ops(const string& name, vector<int> a, vector<int> b)
+{
+    vector<int> u, i, d;
+    set_union(a.begin(), a.end(), b.begin(), b.end(), back_inserter(u));
+    set_intersection(a.begin(), a.end(), b.begin(), b.end(), back_inserter(i));
+    set_difference(a.begin(), a.end(), b.begin(), b.end(), back_inserter(d));
+
+    S<int> A(a.data(), (int)a.size());
+    S<int> B(b.data(), (int)b.size());
+    S<int> U(u.data(), (int)u.size());
+    S<int> I(i.data(), (int)i.size());
+    S<int> D(d.data(), (int)d.size());
+
+    string sizes = name + " |A| = " + to_string(a.size()) + ", |B| = " + to_string(b.size());
+
+    S<int> C(A);
+    C += B;
+    expect(C == U && C.cardinality() == (int)u.size(), sizes + ": A += B");
+
+    C = A;
+    C *= B;
+    expect(C == I && C.cardinality() == (int)i.size(), sizes + ": A *= B");
+
+    C = A;
+    C -= B;
+    expect(C == D && C.cardinality() == (int)d.size(), sizes + ": A -= B");
+
+    C = B;
+    C *= A;
+    expect(C == I, sizes + ": B *= A");
+
+    expect(S<int>(A + B) == U, sizes + ": A + B");
+    expect(S<int>(B * A) == I, sizes + ": B * A");
+    expect(S<int>(A - B) == D, sizes + ": A - B");
+}
+
+//Same elements, in the same order, and the same cardinality
+bool same(const Set<int>& S, const set<int>& R)
+{
+    return S.cardinality() == (int)R.size() && equal(S.begin(), S.end(), R.begin(), R.end());
+}
+
+//Membership, lower_bound and upper_bound of every value in [lo, hi)
+bool same_search(const Set<int>& S, const set<int>& R, int lo, int hi)
+{
+    for (int v = lo; v < hi; ++v)
+    {
+        if (S.is_member(v) != (R.count(v) == 1)) return false;
+
+        auto l = S.lower_bound(v);
+        auto rl = R.lower_bound(v);
+        if ((l == S.end()) != (rl == R.end()) || (rl != R.end() && *l != *rl)) return false;
+
+        auto u = S.upper_bound(v);
+        auto ru = R.upper_bound(v);
+        if ((u == S.end()) != (ru == R.end()) || (ru != R.end() && *u != *ru)) return false;
+    }
+    return true;
+}
+
+//Random inserts and removes on a Set with the skip-list index, then the assignments
+//that move the towers between sets with and without the index
+void check_index(unsigned seed)
+{
+    Set<int> S;
+    S.use_index();
+    set<int> R;
+
+    for (int k = 0; k < 4000; ++k)
+    {
+        int v = (int)(next_rand(seed) % 1000);
+        if (next_rand(seed) % 3 == 0)
+        {
+            S.remove(v);
+            R.erase(v);
+        }
+        else
+        {
+            S.insert(v);
+            R.insert(v);
+        }
+    }
+    expect(same(S, R), "indexed Set after inserts and removes");
+    expect(same_search(S, R, -1, 1001), "indexed Set, is_member, lower_bound and upper_bound");
+
+    //B gets the towers of S in the assignment and drops them, C uses the index again
+    Set<int> B;
+    B = S;
+    Set<int> C;
+    C.use_index();
+    C = B;
+    expect(same_search(C, R, -1, 1001), "indexed Set assigned from a set without index");
+
+    //A copy of an indexed set is indexed, and changes apart from the original
+    Set<int> D(S);
+    D.insert(5000);
+    D.remove(*R.begin());
+    expect(same_search(S, R, -1, 1001), "indexed Set after its copy changed");
+    expect(D.is_member(5000) && !D.is_member(*R.begin()), "copy of an indexed Set");
+
+    //Merges rebuild the index
+    int a[] = { 1, 2, 500, 999 };
+    Set<int> E(a, 4);
+    S += E;
+    S -= Set<int>(2);
+    R.insert({ 1, 500, 999 });
+    R.erase(2);
+    expect(same_search(S, R, -1, 1001), "indexed Set after += and -=");
+
+    S.use_index(false);
+    expect(same_search(S, R, -1, 1001), "Set after the index is turned off");
+    S.make_empty();
+    S.use_index();
+    expect(!S.is_member(1) && S.lower_bound(0) == S.end(), "empty indexed Set");
+}
+
+//Union '+', intersection '*' or difference '-' of two std::set
+set<int> reference(const set<int>& a, char op, const set<int>& b)
+{
+    set<int> r;
+    auto out = inserter(r, r.end());
+    if (op == '+') set_union(a.begin(), a.end(), b.begin(), b.end(), out);
+    if (op == '*') set_intersection(a.begin(), a.end(), b.begin(), b.end(), out);
+    if (op == '-') set_difference(a.begin(), a.end(), b.begin(), b.end(), out);
+    return r;
+}
+
+//Three random sets, the first of them indexed on odd seeds
+struct Operands
+{
+    set<int> ra, rb, rc;
+    Set<int> A, B, C;
+
+    explicit Operands(unsigned seed)
+    {
+        vector<int> a = make_ids(seed % 5 == 0 ? 0 : (int)(seed * 53 % 200), 0, 300, seed);
+        vector<int> b = make_ids((int)(seed * 31 % 150), 0, 300, seed + 1000);
+        vector<int> c = make_ids((int)(seed * 17 % 100), 0, 300, seed + 2000);
+
+        ra.insert(a.begin(), a.end());
+        rb.insert(b.begin(), b.end());
+        rc.insert(c.begin(), c.end());
+        A = Set<int>(a.data(), (int)a.size());
+        B = Set<int>(b.data(), (int)b.size());
+        C = Set<int>(c.data(), (int)c.size());
+        if (seed % 2) A.use_index();
+    }
+};
+
+//Lazy expressions, converted to a Set, queried without converting them, compared with sets
+void check_expressions(unsigned seed)
+{
+    Operands o(seed);
+    const Set<int>& A = o.A;
+    const Set<int>& B = o.B;
+    const Set<int>& C = o.C;
+    string what = "expressions, seed " + to_string(seed) + ": ";
+
+    expect(same(Set<int>(A + B), reference(o.ra, '+', o.rb)), what + "A + B");
+    expect(same(Set<int>(A * B), reference(o.ra, '*', o.rb)), what + "A * B");
+    expect(same(Set<int>(A - B), reference(o.ra, '-', o.rb)), what + "A - B");
+    expect(same(Set<int>(A + A), o.ra) && same(Set<int>(A * A), o.ra) && Set<int>(A - A)._empty(),
+           what + "A + A, A * A and A - A");
+
+    set<int> r = reference(reference(o.ra, '+', o.rb), '*', o.rc);
+    r = reference(r, '-', reference(o.rb, '-', o.ra));
+    expect(same(Set<int>((A + B) * C - (B - A)), r), what + "(A + B) * C - (B - A)");
+
+    //Values and temporary sets are kept in the expression
+    set<int> r7 = o.ra;
+    r7.insert(7);
+    expect(same(Set<int>(A + 7), r7) && same(Set<int>(7 + A), r7), what + "A + 7 and 7 + A");
+    r7.erase(7);
+    r7.erase(8);
+    expect(same(Set<int>(A - 8 - 7), r7), what + "A - 8 - 7");
+    expect(same(Set<int>(Set<int>(B) * (A + C)), reference(o.rb, '*', reference(o.ra, '+', o.rc))),
+           what + "Set(B) * (A + C)");
+
+    auto E = (A + B) - C;
+    r = reference(reference(o.ra, '+', o.rb), '-', o.rc);
+    expect(E.cardinality() == (int)r.size() && E._empty() == r.empty(), what + "cardinality of an expression");
+
+    bool members = true;
+    for (int v = -1; v <= 300; ++v) members = members && E.is_member(v) == (r.count(v) == 1);
+    expect(members, what + "is_member of an expression");
+
+    Set<int> S(r.begin(), r.end());
+    expect(E == S && !(E != S) && E <= S && !(E < S), what + "expression compared with an equal set");
+    expect((A * B) <= A && (A * B) <= B, what + "A * B <= A and A * B <= B");
+    expect(((A - B) < A) == !reference(o.ra, '*', o.rb).empty(), what + "A - B < A");
+    expect(same((A * B) += C, reference(reference(o.ra, '*', o.rb), '+', o.rc)), what + "(A * B) += C");
+
+    expect(same(A, o.ra) && same(B, o.rb) && same(C, o.rc), what + "operands unchanged");
+}
+
+//Operators with a temporary operand, computed at once in the storage of the temporary
+void check_temporaries(unsigned seed)
+{
+    Operands o(seed);
+    const Set<int>& A = o.A;
+    const Set<int>& B = o.B;
+    string what = "temporaries, seed " + to_string(seed) + ": ";
+
+    set<int> u = reference(o.ra, '+', o.rb);
+    set<int> i = reference(o.ra, '*', o.rb);
+
+    expect(same(Set<int>(A) + B, u) && same(B + Set<int>(A), u), what + "Set(A) + B and B + Set(A)");
+    expect(same(Set<int>(A) * B, i) && same(B * Set<int>(A), i), what + "Set(A) * B and B * Set(A)");
+    expect(same(Set<int>(A) + Set<int>(B), u), what + "Set(A) + Set(B)");
+    expect(same(Set<int>(A) - B, reference(o.ra, '-', o.rb)), what + "Set(A) - B");
+    expect(same(Set<int>(B - Set<int>(A)), reference(o.rb, '-', o.ra)), what + "B - Set(A)");
+
+    Set<int> X(A);
+    Set<int> Y = std::move(X) * B;
+    expect(same(Y, i), what + "std::move(X) * B");
+    Y = std::move(Y) + o.C;
+    expect(same(Y, reference(i, '+', o.rc)), what + "std::move(Y) + C");
+
+    expect(same(A, o.ra) && same(B, o.rb), what + "operands unchanged");
+}
+
+//Union and intersection of k sets in one pass, against pairwise std::set results
+void check_all(int k, unsigned seed)
+{
+    vector<Set<int>> sets;
+    set<int> u, i;
+    string what = "union_all and intersect_all, " + to_string(k) + " sets, seed " + to_string(seed);
+
+    for (int n = 0; n < k; ++n)
+    {
+        //Dense sets, so that the intersection is seldom empty
+        vector<int> v = make_ids(150 + (int)(next_rand(seed) % 100), 0, 250, seed + n);
+        set<int> r(v.begin(), v.end());
+
+        sets.push_back(Set<int>(v.data(), (int)v.size()));
+        u = reference(u, '+', r);
+        i = n == 0 ? r : reference(i, '*', r);
+    }
+
+    expect(same(Set<int>::union_all(sets), u), what + ": union_all");
+    expect(same(Set<int>::intersect_all(sets), i), what + ": intersect_all");
+
+    sets.push_back(Set<int>());
+    expect(same(Set<int>::union_all(sets), u), what + " and an empty set: union_all");
+    expect(Set<int>::intersect_all(sets)._empty(), what + " and an empty set: intersect_all");
+}
+
+//Batches that are looked up one by one, merged sorted, and sorted first, with and without the index
+void check_contains_many(unsigned seed)
+{
+    vector<int> v = make_ids(2000, 0, 4000, seed);
+    set<int> r(v.begin(), v.end());
+    Set<int> S(v.data(), (int)v.size());
+
+    for (int indexed = 0; indexed <= 1; ++indexed)
+    {
+        S.use_index(indexed == 1);
+
+        for (int k : { 0, 1, 5, 300, 5000 })
+        {
+            vector<int> batch;
+            for (int n = 0; n < k; ++n) batch.push_back((int)(next_rand(seed) % 4100) - 50);
+
+            for (int sorted = 0; sorted <= 1; ++sorted)
+            {
+                if (sorted) sort(batch.begin(), batch.end());
+
+                vector<bool> found(3, true);
+                S.contains_many(batch.begin(), batch.end(), found);
+
+                bool ok = found.size() == batch.size();
+                for (size_t n = 0; ok && n < batch.size(); ++n) ok = found[n] == (r.count(batch[n]) == 1);
+
+                expect(ok, "contains_many, seed " + to_string(seed) + ", " + to_string(k) +
+                           (sorted ? " sorted" : " unsorted") + " values" + (indexed ? ", indexed" : ""));
+            }
+        }
+    }
+}
+
+//Forward and reverse iteration, ranges [lo, hi) of a set and ranges as operands
+void check_ranges(unsigned seed)
+{
+    Operands o(seed);
+    const Set<int>& A = o.A;
+    string what = "iterators and ranges, seed " + to_string(seed) + ": ";
+
+    expect(equal(A.rbegin(), A.rend(), o.ra.rbegin(), o.ra.rend()), what + "reverse iteration");
+    expect(A._empty() || (*--A.end() == *o.ra.rbegin() && *A.begin()++ == *o.ra.begin()),
+           what + "--end() and begin()++");
+    expect(count_if(A.begin(), A.end(), [](int v) { return v % 3 == 0; }) ==
+           count_if(o.ra.begin(), o.ra.end(), [](int v) { return v % 3 == 0; }), what + "count_if");
+
+    for (int lo = -10; lo <= 310; lo += 40)
+    {
+        for (int hi : { lo - 1, lo, lo + 1, lo + 75, 400 })
+        {
+            set<int> r(o.ra.lower_bound(lo), lo < hi ? o.ra.lower_bound(hi) : o.ra.lower_bound(lo));
+            string bounds = "[" + to_string(lo) + ", " + to_string(hi) + ")";
+
+            SetRange<int> in = A.range(lo, hi);
+            expect(equal(in.begin(), in.end(), r.begin(), r.end()) && same(Set<int>(in), r),
+                   what + "range " + bounds);
+            expect(same(Set<int>(in * o.B), reference(r, '*', o.rb)) &&
+                   same(Set<int>(o.B - in), reference(o.rb, '-', r)) &&
+                   same(Set<int>(in + o.C), reference(r, '+', o.rc)),
+                   what + "range " + bounds + " as an operand");
+        }
+    }
+}
+
+//Every vector kernel against the scalar one, writing in place over a
+void check_kernels(vector<int> a, vector<int> b)
+{
+    const SimdLevel levels[] = { SimdLevel::Scalar, SimdLevel::SSE4, SimdLevel::AVX2 };
+
+    vector<int> i, d;
+    set_intersection(a.begin(), a.end(), b.begin(), b.end(), back_inserter(i));
+    set_difference(a.begin(), a.end(), b.begin(), b.end(), back_inserter(d));
+
+    for (SimdLevel level : levels)
+    {
+        if (level > simd_level()) break;
+
+        vector<int> out(a);
+        out.resize(intersect_sorted(out.data(), out.size(), b.data(), b.size(), out.data(), level));
+        expect(out == i, "intersect_sorted in place, |a| = " + to_string(a.size()) +
+                         ", |b| = " + to_string(b.size()) + ", level " + to_string((int)level));
+
+        out = a;
+        out.resize(difference_sorted(out.data(), out.size(), b.data(), b.size(), out.data(), level));
+        expect(out == d, "difference_sorted in place, |a| = " + to_string(a.size()) +
+                         ", |b| = " + to_string(b.size()) + ", level " + to_string((int)level));
+    }
+}
+
+int main()
+{
+    /*****************************************************
+    * TEST PHASE 1                                       *
+    * Empty operands                                     *
+    ******************************************************/
+    cout << "TEST PHASE 1: empty operands\n";
+
+    vector<int> none;
+    vector<int> some = make_ids(50, -100, 200, 1);
+
+    check_ops<FlatSet>("FlatSet", none, none);
+    check_ops<FlatSet>("FlatSet", none, some);
+    check_ops<FlatSet>("FlatSet", some, none);
+    check_ops<BitmapSet>("BitmapSet", none, none);
+    check_ops<BitmapSet>("BitmapSet", none, some);
+    check_ops<BitmapSet>("BitmapSet", some, none);
+    check_kernels(none, some);
+    check_kernels(some, none);
+
+    /*****************************************************
+    * TEST PHASE 2                                       *
+    * Operand sizes that differ more than GALLOP_RATIO   *
+    ******************************************************/
+    cout << "TEST PHASE 2: skewed operand sizes\n";
+
+    vector<int> large = make_ids(4000, 0, 8000, 2);
+    vector<int> small_inside = { large[0], 17, large[1000], 4001, large.back() };
+    vector<int> small_outside = { -5, -1, 9000, 9001 };
+
+    for (const vector<int>& small : { small_inside, small_outside })
+    {
+        expect(small.size() * 32 < large.size(), "ratio above GALLOP_RATIO");
+        check_ops<FlatSet>("FlatSet", small, large);
+        check_ops<FlatSet>("FlatSet", large, small);
+        check_ops<BitmapSet>("BitmapSet", small, large);
+        check_ops<BitmapSet>("BitmapSet", large, small);
+    }
+
+    /*****************************************************
+    * TEST PHASE 3                                       *
+    * Sizes that leave a tail after the vector blocks    *
+    ******************************************************/
+    cout << "TEST PHASE 3: vector kernel tails\n";
+
+    for (int na = 0; na <= 19; ++na)
+    {
+        for (int nb = 0; nb <= 19; ++nb)
+        {
+            vector<int> a = make_ids(na, 0, 40, 100 + na);
+            vector<int> b = make_ids(nb, 0, 40, 200 + nb);
+
+            check_kernels(a, b);
+            check_ops<FlatSet>("FlatSet", a, b);
+        }
+    }
+
+    /*****************************************************
+    * TEST PHASE 4                                       *
+    * BitmapSet containers and chunk boundaries          *
+    ******************************************************/
+    cout << "TEST PHASE 4: BitmapSet containers\n";
+
+    vector<int> dense, runs, edges;
+    for (int v = 0; v < 10000; v += 2) dense.push_back(v);                 // bitmap chunk
+    for (int v = 100; v < 70000; ++v) if (v % 1000 < 900) runs.push_back(v); // runs across a boundary
+    edges = { -65537, -65536, -1, 0, 65535, 65536, 131071 };
+
+    check_ops<BitmapSet>("BitmapSet", dense, runs);
+    check_ops<BitmapSet>("BitmapSet", runs, dense);
+    check_ops<BitmapSet>("BitmapSet", edges, runs);
+    check_ops<BitmapSet>("BitmapSet", dense, edges);
+
+    /*****************************************************
+    * TEST PHASE 5                                       *
+    * Parallel partitioned merge                         *
+    ******************************************************/
+    cout << "TEST PHASE 5: parallel merge\n";
+
+    size_t threshold = FlatSet<int>::parallel_threshold;
+    unsigned threads = FlatSet<int>::parallel_threads;
+    FlatSet<int>::parallel_threshold = 0;
+
+    for (unsigned th = 1; th <= 5; ++th)
+    {
+        FlatSet<int>::parallel_threads = th;
+        check_ops<FlatSet>("FlatSet " + to_string(th) + " threads", make_ids(3000, 0, 5000, 3), make_ids(2000, 0, 5000, 4));
+        check_ops<FlatSet>("FlatSet " + to_string(th) + " threads", make_ids(7, 0, 5000, 5), make_ids(2000, 0, 5000, 6));
+        check_ops<FlatSet>("FlatSet " + to_string(th) + " threads", none, make_ids(20, 0, 50, 7));
+    }
+
+    FlatSet<int>::parallel_threshold = threshold;
+    FlatSet<int>::parallel_threads = threads;
+
+    /*****************************************************
+    * TEST PHASE 6                                       *
+    * Skip-list index of Set                             *
+    ******************************************************/
+    cout << "TEST PHASE 6: Set index\n";
+
+    for (unsigned seed = 1; seed <= 5; ++seed)
+    {
+        check_index(seed);
+    }
+
+    /*****************************************************
+    * TEST PHASE 7                                       *
+    * Lazy Set expressions                               *
+    ******************************************************/
+    cout << "TEST PHASE 7: Set expressions\n";
+
+    for (unsigned seed = 1; seed <= 20; ++seed)
+    {
+        check_expressions(seed);
+    }
+
+    /*****************************************************
+    * TEST PHASE 8                                       *
+    * Set operators on temporary sets                    *
+    ******************************************************/
+    cout << "TEST PHASE 8: Set operators on temporaries\n";
+
+    for (unsigned seed = 1; seed <= 20; ++seed)
+    {
+        check_temporaries(seed);
+    }
+
+    /*****************************************************
+    * TEST PHASE 9                                       *
+    * Union and intersection of many sets                *
+    ******************************************************/
+    cout << "TEST PHASE 9: union_all and intersect_all\n";
+
+    for (int k = 0; k <= 8; ++k)
+    {
+        check_all(k, 10 * k + 1);
+    }
+
+    /*****************************************************
+    * TEST PHASE 10                                      *
+    * Batched membership queries                         *
+    ******************************************************/
+    cout << "TEST PHASE 10: contains_many\n";
+
+    for (unsigned seed = 1; seed <= 3; ++seed)
+    {
+        check_contains_many(seed);
+    }
+
+    /*****************************************************
+    * TEST PHASE 11                                      *
+    * Iterators and ranges of Set                        *
+    ******************************************************/
+    cout << "TEST PHASE 11: iterators and ranges\n";
+
+    for (unsigned seed = 1; seed <= 10; ++seed)
+    {
+        check_ranges(seed);
+    }
+
+    cout << (failed ? "\nSome tests FAILED" : "\nAll tests PASSED") << endl;
+
+    return failed ? 1 : 0;
+}
@@ -1,9 +1,12 @@
 /*
   Author: Aida Nordman
   Course: TND004, Lab 2
-  Description: template class Item and derived class Deleted_Item
+  Description: template class Item
 */
 
+#ifndef ITEM_H
+#define ITEM_H
+
 #include <iostream>
 #include <iomanip>
 #include <new>
@@ -45,7 +48,9 @@ public:
 protected:
 
     //data members
-    const Key_Type key;
+    //key is not const so that the tables can move items between slots
+    //Client code can only read it, through get_key
+    Key_Type key;
     Value_Type value;
 
     friend ostream& operator<<(ostream& os, const Item& i)
@@ -57,44 +62,4 @@ protected:
     }
 };
 
-/* ********************************** *
-* Derived class Deleted_Item          *
-* *********************************** */
-
-
- //Template class to represent a deleted item
- //One unique instance of this class is used to mark deleted slots of the hash table
-template <typename Key_Type, typename Value_Type>
-class Deleted_Item: public Item<Key_Type,Value_Type>
-{
-public:
-
-    //Return pointer to the item used to mark deleted entries in the table
-    static Deleted_Item *get_Item()
-    {
-        if (!entry)
-        {
-            entry = new Deleted_Item();
-
-            //cout << "Dummy item created!!" << endl;
-        }
-
-        return entry;
-    }
-
-private:
-
-    //Only one instance of the class is needed to mark deleted slots of the table
-    static Deleted_Item *entry;
-
-    //Default constructor
-    //Private member function so that only member functions can create class instances
-    Deleted_Item()
-        : Item<Key_Type,Value_Type>(Key_Type(), Value_Type()) { }
-
-};
-
-
-//Initialize static data member (entry)
-template <typename Key_Type, typename Value_Type>
-Deleted_Item<Key_Type,Value_Type> *Deleted_Item<Key_Type,Value_Type>::entry = nullptr;
+#endif // ITEM_H
@@ -0,0 +1,166 @@
+/*
+  Course: TND004, Lab 2
+  Description: benchmark of the word frequency table, HashTable (Robin Hood probing) vs SwissTable (group probing)
+  Usage: bench [text files...]   (default: the test files in "Other files")
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+
+#include "hashTable.h"
+#include "swissTable.h"
+
+using namespace std;
+
+const string PUNCT = ".,!?:\"();";
+
+const int TABLE_SIZE = 800;
+
+//Lookups of every word, per run
+const int LOOKUP_ROUNDS = 20;
+
+
+//Hash function for English words, the one of main.cpp
+struct Word_Hash
+{
+    size_t operator()(const string& s) const
+    {
+        unsigned hashVal = 0;
+
+        for(unsigned i = 0; i < s.length(); i++)
+            hashVal = 37 * hashVal + s[i];
+
+        return hashVal;
+    }
+};
+
+//Time in milliseconds to run f
+template <class F>
+double time_ms(F f)
+{
+    auto start = chrono::steady_clock::now();
+    f();
+    auto stop = chrono::steady_clock::now();
+
+    return chrono::duration<double, milli>(stop - start).count();
+}
+
+//Words of a file, in lower case and without punctuation, as main.cpp reads them
+vector<string> read_words(const string& name)
+{
+    ifstream file_in(name);
+    vector<string> words;
+    string s;
+
+    while (file_in >> s)
+    {
+        transform(s.begin(), s.end(), s.begin(), ::tolower);
+
+        string s1;
+        copy_if(s.begin(), s.end(), back_inserter(s1), [](char c)
+        {
+            return (PUNCT.find(c) == string::npos);
+        });
+
+        words.push_back(s1);
+    }
+
+    return words;
+}
+
+struct Timings
+{
+    double count, lookup, remove;
+    double visited;     //average visited slots per operation
+};
+
+//Count the words, look every word up LOOKUP_ROUNDS times, then remove every word
+template <template <class, class, class, class> class Table>
+Timings run(const vector<string>& words)
+{
+    Timings t;
+    long long check = 0;
+
+    //HashTable reports every rehash on cout
+    ostringstream quiet;
+    streambuf* old = cout.rdbuf(quiet.rdbuf());
+
+    Table<string, int, Word_Hash, equal_to<string>> table(TABLE_SIZE);
+
+    t.count = time_ms([&]() {
+        for (const string& w : words) table[w]++;
+    });
+
+    t.lookup = time_ms([&]() {
+        for (int r = 0; r < LOOKUP_ROUNDS; ++r)
+            for (const string& w : words) check += *table._find(w);
+    });
+
+    unsigned before = table.get_total_visited_slots();
+    t.remove = time_ms([&]() {
+        for (const string& w : words) check += table._remove(w);
+    });
+
+    cout.rdbuf(old);
+
+    t.visited = (double)before / (words.size() * (1 + LOOKUP_ROUNDS));
+    cout << "  (check " << check << ", " << table.get_number_OF_items() << " left)" << endl;
+
+    return t;
+}
+
+void report(const string& op, double linear, double swiss)
+{
+    cout << setw(14) << op << ": "
+         << setw(10) << fixed << setprecision(2) << linear << " ms"
+         << setw(10) << swiss << " ms"
+         << setw(8) << setprecision(1) << linear / swiss << "x" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    vector<string> files;
+    for (int i = 1; i < argc; ++i) files.push_back(argv[i]);
+    if (files.empty())
+    {
+        files = { "Other files/test_file1.txt", "Other files/test_file2.txt", "Other files/test_file3.txt" };
+    }
+
+    cout << "Group width: " << Swiss_Group::WIDTH << " slots" << endl;
+
+    for (const string& name : files)
+    {
+        vector<string> words = read_words(name);
+        if (words.empty())
+        {
+            cout << "Could not read " << name << endl;
+            continue;
+        }
+
+        cout << endl << name << ": " << words.size() << " words" << endl;
+
+        cout << "HashTable" << endl;
+        Timings linear = run<HashTable>(words);
+
+        cout << "SwissTable" << endl;
+        Timings swiss = run<SwissTable>(words);
+
+        cout << setw(14) << "operation" << ": "
+             << setw(13) << "HashTable" << setw(13) << "SwissTable" << setw(9) << "speedup" << endl;
+
+        report("count", linear.count, swiss.count);
+        report("lookup", linear.lookup, swiss.lookup);
+        report("remove", linear.remove, swiss.remove);
+
+        cout << setw(14) << "visited slots" << ": "
+             << setw(13) << setprecision(2) << linear.visited << setw(13) << swiss.visited << endl;
+    }
+
+    return 0;
+}
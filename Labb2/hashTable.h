@@ -3,13 +3,20 @@
   Author: Aida Nordman
   Course: TND004, Lab 2
   Description: template class HashTable represents an open addressing hash table
-              (also known as closed_hashing) with linear probing
+              (also known as closed_hashing) with Robin Hood probing and backward-shift deletion
 */
 
+#ifndef HASH_TABLE_H
+#define HASH_TABLE_H
+
 #include "Item.h"
 
 #include <iostream>
 #include <iomanip>
+#include <new>
+#include <utility>
+#include <functional>
+#include <cstddef>
 
 using namespace std;
 
@@ -17,31 +24,42 @@ const int NOT_FOUND = -1;
 const double MAX_LOAD_FACTOR = 0.5;
 
 
-//Template class to represent an open addressing hash table using linear probing to resolve collisions
-//Internally the table is represented as an array of pointers to Items
-template <typename Key_Type, typename Value_Type>
+//Template class to represent an open addressing hash table using Robin Hood probing to resolve collisions
+//Internally the table is an array of slots, each slot holds its Item = (key, value) in place
+//Thus, inserting an item allocates nothing and a probe reads a single slot, not an Item elsewhere on the heap
+//
+//Robin Hood probing: each slot records how far its item is from its home slot (probe length)
+//A new item is placed before the first item that is closer to its own home, so the items of a run
+//are ordered by home slot and probe lengths stay short and even
+//A search stops at an item closer to home than the key would be, the key can not be further on
+//Removal shifts the rest of the run back one slot, so no slot is ever marked as deleted
+//Each slot keeps the full hash of its key. A probe compares keys only when the hashes are equal,
+//and rehash moves the items without hashing their keys again
+//
+//Hasher is a function object that returns the full hash of a key, size_t operator()(const Key_Type&) const
+//It does not know the table size, the table reduces the hash to a slot
+//Key_Equal is a function object that tells if two keys are equal
+//Both are template parameters, so the calls can be inlined, and keys are passed by const reference
+template <typename Key_Type, typename Value_Type,
+          typename Hasher = hash<Key_Type>, typename Key_Equal = equal_to<Key_Type>>
 class HashTable
 {
 public:
 
-    //New type HASH: pointer to a hash function
-    typedef unsigned (*HASH)(Key_Type, int);
-
-
     //Constructor to create a hash table
     //table_size is number of slots in the table (next prime number is used)
-    //f is the hash function
-    HashTable(int table_size, HASH f);
+    //f is the hash function, eq the key equality
+    HashTable(int table_size, const Hasher& f = Hasher(), const Key_Equal& eq = Key_Equal());
 
 
     //Destructor
     ~HashTable();
 
 
-    //Return the load factor of the table, i.e. percentage of slots in use or deleted
+    //Return the load factor of the table, i.e. percentage of slots in use
     double loadFactor() const
     {
-        return (double) (nItems+nDeleted) / _size;
+        return (double) nItems / _size;
     }
 
 
@@ -52,12 +70,14 @@ public:
     }
 
     //Return the total number of visited slots (during search, insert, remove, or re-hash)
+    //Slots visited to shift items during insert and remove are included
     unsigned get_total_visited_slots() const
     {
         return total_visited_slots;
     }
 
-    //Return the total number of call to new Item()
+    //Return the total number of Items created in the table
+    //Items are built in their slots, none of them is a separate allocation
     unsigned get_count_new_items() const
     {
         return count_new_items;
@@ -90,9 +110,9 @@ public:
     {
         for (unsigned i = 0; i < T._size; ++i)
         {
-            if (T.hTable[i] && T.hTable[i] != Deleted_Item<Key_Type,Value_Type>::get_Item())
+            if (T.hTable[i].state == FULL)
             {
-                os << *T.hTable[i] << endl;
+                os << T.item(i) << endl;
             }
         }
 
@@ -101,12 +121,26 @@ public:
 
 
     //Display the table for debug and testing purposes
-    //Thus, empty and deleted entries are also displayed
+    //Thus, empty slots are also displayed, and each item with its home slot and probe length
     void display(ostream& os);
 
 
 private:
 
+    typedef Item<Key_Type, Value_Type> Item_Type;
+
+    //State of a slot
+    enum Slot_State : unsigned char { EMPTY = 0, FULL };
+
+    //A slot of the table, the Item is constructed in storage when the slot is FULL
+    struct Slot
+    {
+        Slot_State state;
+        unsigned probe;     //distance from the item's home slot
+        size_t hash;        //h(key) of the item
+        alignas(Item_Type) unsigned char storage[sizeof(Item_Type)];
+    };
+
     /* ********************************** *
     * Data members                        *
     * *********************************** */
@@ -114,23 +148,20 @@ private:
     //Number of slots in the table, a prime number
     unsigned _size;
 
-    //Hash function
-    const HASH h;
+    //Hash function and key equality
+    const Hasher h;
+    const Key_Equal equal;
 
     //Number of items stored in the table
-    //Instances of Deleted_Items are not counted
     unsigned nItems;
 
-    //Number of slots that are marked as deleted
-    unsigned nDeleted;
-
-    //Table is an array of pointers to Items
-    //Each slot of the table stores a pointer to an Item =(key, value)
-    Item<Key_Type, Value_Type>** hTable;
+    //Table is an array of slots
+    //Each FULL slot of the table stores an Item =(key, value)
+    Slot* hTable;
 
     //Some statistics
     unsigned total_visited_slots;  //total number of visited slots
-    unsigned count_new_items;      //number of calls to new Item()
+    unsigned count_new_items;      //number of Items created
 
 
     /* ********************************** *
@@ -143,7 +174,29 @@ private:
     //Disable assignment operator!!
     const HashTable& operator=(const HashTable &) = delete;
 
-    unsigned help_find(const Key_Type& key);
+    //Item stored in slot i, the slot must be FULL
+    Item_Type& item(unsigned i)
+    {
+        return *launder(reinterpret_cast<Item_Type*>(hTable[i].storage));
+    }
+
+    const Item_Type& item(unsigned i) const
+    {
+        return *launder(reinterpret_cast<const Item_Type*>(hTable[i].storage));
+    }
+
+    unsigned help_find(const Key_Type& key, size_t hash, bool& found, unsigned& probe);
+
+    //Slot where an item with hash belongs, for keys known not to be in the table
+    //Only the probe lengths are read, no key is compared. probe is set to its probe length there
+    unsigned find_place(size_t hash, unsigned& probe);
+
+    //Place x, with hash h(x.get_key()), in slot i at probe length probe
+    //The items from slot i up to the next empty slot are shifted one slot forward
+    void place(unsigned i, unsigned probe, size_t hash, Item_Type&& x);
+
+    //Move the item in slot from, and its hash, to slot to, which is EMPTY
+    void move_item(unsigned from, unsigned to, unsigned probe);
 
     void rehash();
 };
@@ -163,23 +216,23 @@ int nextPrime( int n );
 //Constructor to create a hash table
 //table_size number of slots in the table (next prime number is used)
 //f is the hash function
-template <typename Key_Type, typename Value_Type>
-HashTable<Key_Type, Value_Type>::HashTable(int table_size, HASH f)
-    : _size(table_size), h(f), nItems(0), nDeleted(0), total_visited_slots(0), count_new_items(0)
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+HashTable<Key_Type, Value_Type, Hasher, Key_Equal>::HashTable(int table_size, const Hasher& f, const Key_Equal& eq)
+    : _size(table_size), h(f), equal(eq), nItems(0), total_visited_slots(0), count_new_items(0)
 {
     //cout << "ctor, " << "size:" << table_size << endl;
-    hTable = new Item<Key_Type, Value_Type>*[table_size]();
+    hTable = new Slot[table_size]();
 }
 
 
 //Destructor
-template <typename Key_Type, typename Value_Type>
-HashTable<Key_Type, Value_Type>::~HashTable()
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+HashTable<Key_Type, Value_Type, Hasher, Key_Equal>::~HashTable()
 {
     //cout << "dtor" << endl;
     for (size_t i = 0; i < _size; i++) {
-        if(hTable[i] != nullptr) {
-            delete hTable[i];
+        if(hTable[i].state == FULL) {
+            item(i).~Item_Type();
         }
     }
     delete[] hTable;
@@ -188,15 +241,18 @@ HashTable<Key_Type, Value_Type>::~HashTable()
 
 //Return a pointer to the value associated with key
 //If key does not exist in the table then nullptr is returned
-template <typename Key_Type, typename Value_Type>
-const Value_Type* HashTable<Key_Type, Value_Type>::_find(const Key_Type& key)
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+const Value_Type* HashTable<Key_Type, Value_Type, Hasher, Key_Equal>::_find(const Key_Type& key)
 {
-    auto tmp_hash = help_find(key);
+    bool found;
+    unsigned probe;
+    size_t hash = h(key);
+    auto tmp_hash = help_find(key, hash, found, probe);
 
     //cout << "_find, " << "key:" << key << " hash:" << tmp_hash << endl;
 
-    if (hTable[tmp_hash] != nullptr) {
-        return &hTable[tmp_hash]->get_value();
+    if (found) {
+        return &item(tmp_hash).get_value();
     }
     // key not found
     return nullptr;
@@ -205,21 +261,24 @@ const Value_Type* HashTable<Key_Type, Value_Type>::_find(const Key_Type& key)
 //Insert the Item (key, v) in the table
 //If key already exists in the table then change the value associated with key to v
 //Re-hash if the table reaches the MAX_LOAD_FACTOR
-template <typename Key_Type, typename Value_Type>
-void HashTable<Key_Type, Value_Type>::_insert(const Key_Type& key, const Value_Type& v)
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+void HashTable<Key_Type, Value_Type, Hasher, Key_Equal>::_insert(const Key_Type& key, const Value_Type& v)
 {
     //cout << "_insert, " << "key:" << key << " hash:" << tmp_hash << " value:" << v << endl;
 
-    auto tmp_hash = help_find(key);
+    bool found;
+    unsigned probe;
+    size_t hash = h(key);
+    auto tmp_hash = help_find(key, hash, found, probe);
 
-    if (hTable[tmp_hash] == nullptr) {
+    if (!found) {
         // key was not already in hash table
-        hTable[tmp_hash] = new Item<Key_Type, Value_Type>(key,v);
+        place(tmp_hash, probe, hash, Item_Type(key, v));
         count_new_items++;
         nItems++;
     } else {
         // key was already in there, update the value.
-        hTable[tmp_hash]->get_value() = v;
+        item(tmp_hash).get_value() = v;
     }
 
     if(loadFactor() >= 0.5) {
@@ -233,15 +292,28 @@ void HashTable<Key_Type, Value_Type>::_insert(const Key_Type& key, const Value_T
 //Remove Item with key, if the item exists
 //If an Item was removed then return true
 //otherwise, return false
-template <typename Key_Type, typename Value_Type>
-bool HashTable<Key_Type, Value_Type>::_remove(const Key_Type& key)
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+bool HashTable<Key_Type, Value_Type, Hasher, Key_Equal>::_remove(const Key_Type& key)
 {
-    auto tmp_hash = help_find(key);
-
-    if (hTable[tmp_hash] != nullptr) {
-        // Key found, delete item.
-        delete hTable[tmp_hash];
-        hTable[tmp_hash] = Deleted_Item<Key_Type, Value_Type>::get_Item();
+    bool found;
+    unsigned probe;
+    size_t hash = h(key);
+    auto tmp_hash = help_find(key, hash, found, probe);
+
+    if (found) {
+        // Key found, destroy the item
+        item(tmp_hash).~Item_Type();
+        hTable[tmp_hash].state = EMPTY;
+        nItems--;
+
+        // Shift the rest of the run back one slot, up to an empty slot or an item in its home slot
+        unsigned next = (tmp_hash + 1) % _size;
+        while (hTable[next].state == FULL && hTable[next].probe > 0) {
+            total_visited_slots++;
+            move_item(next, tmp_hash, hTable[next].probe - 1);
+            tmp_hash = next;
+            next = (next + 1) % _size;
+        }
         return true;
     }
 
@@ -250,14 +322,17 @@ bool HashTable<Key_Type, Value_Type>::_remove(const Key_Type& key)
 }
 
 // Return reference to the value of the object that has the supplied key..
-template <typename Key_Type, typename Value_Type>
-Value_Type& HashTable<Key_Type, Value_Type>::operator[](const Key_Type& key)
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+Value_Type& HashTable<Key_Type, Value_Type, Hasher, Key_Equal>::operator[](const Key_Type& key)
 {
-    auto tmp_hash = help_find(key);
-    if (hTable[tmp_hash] == nullptr) {
+    bool found;
+    unsigned probe;
+    size_t hash = h(key);
+    auto tmp_hash = help_find(key, hash, found, probe);
+    if (!found) {
         // Key not found, insert new default value
 
-        hTable[tmp_hash] = new Item<Key_Type, Value_Type>(key,Value_Type());
+        place(tmp_hash, probe, hash, Item_Type(key, Value_Type()));
         count_new_items++;
         nItems++;
 
@@ -265,20 +340,21 @@ Value_Type& HashTable<Key_Type, Value_Type>::operator[](const Key_Type& key)
             rehash();
 
             // Will always find key because we just inserted it.
-            return hTable[help_find(key)]->get_value();
+            return item(help_find(key, hash, found, probe)).get_value();
         }
-        return hTable[tmp_hash]->get_value();
+        return item(tmp_hash).get_value();
     }
 
     // Key found, return ref to value.
-    return hTable[tmp_hash]->get_value();
+    return item(tmp_hash).get_value();
 }
 
 //Display the table for debug and testing purposes
 //This function is used for debugging and testing purposes
-//Thus, empty and deleted entries are also displayed
-template <typename Key_Type, typename Value_Type>
-void HashTable<Key_Type, Value_Type>::display(ostream& os)
+//Thus, empty slots are also displayed. There are no deleted slots, removal shifts the run back
+//Each item is followed by its home slot and its probe length
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+void HashTable<Key_Type, Value_Type, Hasher, Key_Equal>::display(ostream& os)
 {
     os << "-------------------------------\n";
     os << "Number of items in the table: " << get_number_OF_items() << endl;
@@ -288,18 +364,14 @@ void HashTable<Key_Type, Value_Type>::display(ostream& os)
     {
         os << setw(6) << i << ": ";
 
-        if (!hTable[i])
+        if (hTable[i].state == EMPTY)
         {
             os << "null" << endl;
         }
-        else if (hTable[i] == Deleted_Item<Key_Type, Value_Type>::get_Item())
-        {
-            os << "deleted" << endl;
-        }
         else
         {
-            os << *hTable[i]
-               << "  (" << h(hTable[i]->get_key(),_size) << ")" << endl;
+            os << item(i)
+               << "  (" << hTable[i].hash % _size << ", probe " << hTable[i].probe << ")" << endl;
         }
     }
 
@@ -314,32 +386,90 @@ void HashTable<Key_Type, Value_Type>::display(ostream& os)
 
 
 // Finds the element represented by key or the slot where it should be placed
-// by using linear probing.
-template <typename Key_Type, typename Value_Type>
-unsigned HashTable<Key_Type, Value_Type>::help_find(const Key_Type& key)
+// by using Robin Hood probing. found tells which, probe is the probe length of the slot
+// hash is h(key), computed once by the caller
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+unsigned HashTable<Key_Type, Value_Type, Hasher, Key_Equal>::help_find(const Key_Type& key, size_t hash, bool& found, unsigned& probe)
 {
-    auto tmp_hash = h(key, _size);
+    unsigned tmp_hash = hash % _size;
+    probe = 0;
+    found = false;
 
     //cout << "help_find, " << "key:" << key << " hash:" << tmp_hash << endl;
 
-    while(hTable[tmp_hash] != nullptr) {
+    // An item closer to its home than probe means key is not in the table,
+    // key belongs in its slot
+    while(hTable[tmp_hash].state == FULL && hTable[tmp_hash].probe >= probe) {
         total_visited_slots++;
-        if (hTable[tmp_hash]->get_key() == key) {
+        // Keys with the same hash have the same home, and so the same probe length here
+        if (hTable[tmp_hash].hash == hash && equal(item(tmp_hash).get_key(), key)) {
+            found = true;
             return tmp_hash;
         }
         // Wrap around to 0
         tmp_hash++;
         tmp_hash = tmp_hash % _size;
+        probe++;
     }
     total_visited_slots++;
 
-    // key was not found, return the currently selected slot. We are guaranteed to always find
+    // key was not found, return the slot where it should be placed. We are guaranteed to always find
     // an empty slot because table will rehash if load factor gets to 0.5
     return tmp_hash;
 }
 
-template <typename Key_Type, typename Value_Type>
-void HashTable<Key_Type, Value_Type>::rehash()
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+unsigned HashTable<Key_Type, Value_Type, Hasher, Key_Equal>::find_place(size_t hash, unsigned& probe)
+{
+    unsigned tmp_hash = hash % _size;
+    probe = 0;
+
+    // Skip the items at least as far from home, an item with the same hash goes after them
+    while(hTable[tmp_hash].state == FULL && hTable[tmp_hash].probe >= probe) {
+        total_visited_slots++;
+        tmp_hash = (tmp_hash + 1) % _size;
+        probe++;
+    }
+    total_visited_slots++;
+
+    return tmp_hash;
+}
+
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+void HashTable<Key_Type, Value_Type, Hasher, Key_Equal>::place(unsigned i, unsigned probe, size_t hash, Item_Type&& x)
+{
+    // Find the end of the run, then shift it forward starting from the last item
+    unsigned last = i;
+    while (hTable[last].state == FULL) {
+        total_visited_slots++;
+        last = (last + 1) % _size;
+    }
+    while (last != i) {
+        unsigned prev = (last + _size - 1) % _size;
+        move_item(prev, last, hTable[prev].probe + 1);
+        last = prev;
+    }
+
+    new (hTable[i].storage) Item_Type(std::move(x));
+    hTable[i].state = FULL;
+    hTable[i].probe = probe;
+    hTable[i].hash = hash;
+}
+
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+void HashTable<Key_Type, Value_Type, Hasher, Key_Equal>::move_item(unsigned from, unsigned to, unsigned probe)
+{
+    new (hTable[to].storage) Item_Type(std::move(item(from)));
+    hTable[to].state = FULL;
+    hTable[to].probe = probe;
+    hTable[to].hash = hTable[from].hash;
+
+    item(from).~Item_Type();
+    hTable[from].state = EMPTY;
+}
+
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+void HashTable<Key_Type, Value_Type, Hasher, Key_Equal>::rehash()
 {
     auto old_hTable = hTable;
     auto old_size = _size;
@@ -348,26 +478,26 @@ void HashTable<Key_Type, Value_Type>::rehash()
 
     // Allocate a new array
     _size = nextPrime(2 * old_size);
-    hTable = new Item<Key_Type, Value_Type>*[_size]();
+    hTable = new Slot[_size]();
 
     cout << "Rehash..\n" <<
             "New table size " << _size << endl;
 
-    // Copy elements over to new array
+    // Move elements over to new array, with the hashes stored in the old one
+    // The keys are known to be distinct, so they are not compared
     for (size_t i = 0; i < old_size; i++) {
-        if (old_hTable[i] != nullptr && old_hTable[i] != Deleted_Item<Key_Type, Value_Type>::get_Item()) {
-            //_insert(old_hTable[i]->get_key(), old_hTable[i]->get_value());
-            hTable[help_find(old_hTable[i]->get_key())] = old_hTable[i];
-            old_hTable[i] = nullptr;
+        if (old_hTable[i].state == FULL) {
+            Item_Type* old_item = launder(reinterpret_cast<Item_Type*>(old_hTable[i].storage));
+            size_t hash = old_hTable[i].hash;
+            unsigned probe;
+            unsigned j = find_place(hash, probe);
+
+            place(j, probe, hash, std::move(*old_item));
+            old_item->~Item_Type();
         }
     }
 
     // delete old array
-    for (size_t i = 0; i < old_size; i++) {
-        if(old_hTable[i] != nullptr) {
-            delete old_hTable[i];
-        }
-    }
     delete[] old_hTable;
 }
 
@@ -404,4 +534,4 @@ int nextPrime( int n )
     return n;
 }
 
-
+#endif // HASH_TABLE_H
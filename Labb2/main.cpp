@@ -27,11 +27,14 @@ const string PUNCT = ".,!?:\"();";
 //Polynomial accumulation
 //the Horner's rule is used to compute the value
 //See pag. 213 of course book
-unsigned _hash(string s, int tableSize);
+struct Word_Hash
+{
+    size_t operator()(const string& s) const;
+};
 
 int main()
 {
-    HashTable<string,int> freq_table(TABLE_SIZE, _hash);
+    HashTable<string,int,Word_Hash> freq_table(TABLE_SIZE);
 
     string name;
 
@@ -107,14 +110,13 @@ int main()
 //Polynomial accumulation
 //the Horner's rule is used to compute the value
 //See pag. 213 of course book
-unsigned _hash(string s, int tableSize)
+//The table takes the value modulo its size
+size_t Word_Hash::operator()(const string& s) const
 {
     unsigned hashVal = 0;
 
     for(unsigned i = 0; i < s.length(); i++)
         hashVal = 37 * hashVal + s[i];
 
-    hashVal %= tableSize;
-
     return hashVal;
 }
@@ -0,0 +1,567 @@
+/*
+  Course: TND004, Lab 2
+  Description: template class SwissTable, an open addressing hash table that probes
+              a group of slots at a time through an array of one byte control codes
+*/
+
+#ifndef SWISS_TABLE_H
+#define SWISS_TABLE_H
+
+#include "Item.h"
+
+#include <iostream>
+#include <iomanip>
+#include <new>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <functional>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+//Maximum load factor, deleted slots included
+const double SWISS_MAX_LOAD_FACTOR = 0.875;
+
+//The low 7 bits of the hash of a key are its fingerprint, the other bits select the first group to probe
+
+
+//Control bytes of a group of slots, scanned all at once
+//AVX2 compares 32 bytes per instruction, SSE2 16, otherwise the bytes are compared one by one
+//The group width is fixed when the table is compiled, -mavx2 (or -march=native) selects AVX2
+struct Swiss_Group
+{
+    //Control codes: a FULL slot holds the 7-bit fingerprint of its key, 0..127
+    static const int8_t EMPTY = -128;
+    static const int8_t DELETED = -2;
+
+#if defined(__AVX2__)
+    static const unsigned WIDTH = 32;
+
+    //Bit i is set when slot i of the group has fingerprint h2
+    static uint32_t match(const int8_t* ctrl, int8_t h2)
+    {
+        __m256i g = _mm256_loadu_si256((const __m256i*)ctrl);
+        return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(g, _mm256_set1_epi8(h2)));
+    }
+
+    //Bit i is set when slot i is EMPTY or DELETED, the two codes with the high bit set
+    static uint32_t match_free(const int8_t* ctrl)
+    {
+        return (uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)ctrl));
+    }
+#elif defined(__SSE2__)
+    static const unsigned WIDTH = 16;
+
+    static uint32_t match(const int8_t* ctrl, int8_t h2)
+    {
+        __m128i g = _mm_loadu_si128((const __m128i*)ctrl);
+        return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(h2)));
+    }
+
+    static uint32_t match_free(const int8_t* ctrl)
+    {
+        return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+    }
+#else
+    static const unsigned WIDTH = 16;
+
+    static uint32_t match(const int8_t* ctrl, int8_t h2)
+    {
+        uint32_t bits = 0;
+        for (unsigned i = 0; i < WIDTH; ++i)
+        {
+            bits |= (uint32_t)(ctrl[i] == h2) << i;
+        }
+        return bits;
+    }
+
+    static uint32_t match_free(const int8_t* ctrl)
+    {
+        uint32_t bits = 0;
+        for (unsigned i = 0; i < WIDTH; ++i)
+        {
+            bits |= (uint32_t)(ctrl[i] < 0) << i;
+        }
+        return bits;
+    }
+#endif
+
+    //Bit i is set when slot i is EMPTY
+    static uint32_t match_empty(const int8_t* ctrl)
+    {
+        return match(ctrl, EMPTY);
+    }
+};
+
+
+//Template class to represent an open addressing hash table in the style of a Swiss table
+//The slots are split in groups of Swiss_Group::WIDTH slots, the number of groups is a power of two
+//Each slot has a control byte: EMPTY, DELETED or the fingerprint of the key stored in it
+//A probe compares the fingerprint with the control bytes of a whole group at once,
+//keys are only compared in the slots where the fingerprint matches
+//The groups are probed in triangular order, 0, 1, 3, 6, ... groups away from the first one,
+//which visits every group. A search stops at the first group with an EMPTY slot
+//h(key) is mixed before it is split in the fingerprint and the group, std::hash of an integer
+//is the integer itself and sequential keys would fill the groups in order with few fingerprints
+//Each slot keeps the full hash of its key. A fingerprint match is checked against it before the keys
+//are compared, and rehash moves the items without hashing their keys again
+//
+//The interface and the Hasher and Key_Equal policies are the ones of HashTable, see hashTable.h
+template <typename Key_Type, typename Value_Type,
+          typename Hasher = hash<Key_Type>, typename Key_Equal = equal_to<Key_Type>>
+class SwissTable
+{
+public:
+
+    //Constructor to create a hash table
+    //table_size is the least number of slots in the table (rounded up to a power of two number of groups)
+    //f is the hash function, eq the key equality
+    SwissTable(int table_size, const Hasher& f = Hasher(), const Key_Equal& eq = Key_Equal());
+
+
+    //Destructor
+    ~SwissTable();
+
+
+    //Return the load factor of the table, i.e. percentage of slots in use or deleted
+    double loadFactor() const
+    {
+        return (double) (nItems+nDeleted) / _size;
+    }
+
+
+    //Return number of items stored in the table
+    unsigned get_number_OF_items() const
+    {
+        return nItems;
+    }
+
+    //Return the total number of visited slots (during search, insert, remove, or re-hash)
+    //A group counts as one visited slot, plus one for each key compared in it
+    unsigned get_total_visited_slots() const
+    {
+        return total_visited_slots;
+    }
+
+    //Return the total number of Items created in the table
+    //Items are built in their slots, none of them is a separate allocation
+    unsigned get_count_new_items() const
+    {
+        return count_new_items;
+    }
+
+
+    //Return a pointer to the value associated with key
+    //If key does not exist in the table then nullptr is returned
+    const Value_Type* _find(const Key_Type& key);
+
+
+    //Insert the Item (key, v) in the table
+    //If key already exists in the table then change the value associated with key to v
+    //Re-hash if the table reaches the SWISS_MAX_LOAD_FACTOR
+    void _insert(const Key_Type& key, const Value_Type& v);
+
+
+    //Remove Item with key, if the item exists
+    //If an Item was removed then return true
+    //otherwise, return false
+    bool _remove(const Key_Type& key);
+
+    //Overloaded subscript operator
+    //If key is not in the table then insert a new Item = (key, Value_Type())
+    Value_Type& operator[](const Key_Type& key);
+
+
+    //Display all items in table T to stream os
+    friend ostream& operator<<(ostream& os, const SwissTable& T)
+    {
+        for (unsigned i = 0; i < T._size; ++i)
+        {
+            if (T.ctrl[i] >= 0)
+            {
+                os << T.item(i) << endl;
+            }
+        }
+
+        return os;
+    }
+
+
+    //Display the table for debug and testing purposes
+    //Thus, empty and deleted entries are also displayed
+    void display(ostream& os);
+
+
+private:
+
+    typedef Item<Key_Type, Value_Type> Item_Type;
+
+    //A slot of the table, the Item is constructed in storage when the control byte of the slot is a fingerprint
+    struct Slot
+    {
+        size_t hash;        //hash_of(key) of the item
+        alignas(Item_Type) unsigned char storage[sizeof(Item_Type)];
+    };
+
+    /* ********************************** *
+    * Data members                        *
+    * *********************************** */
+
+    //Number of slots in the table, nGroups * Swiss_Group::WIDTH
+    unsigned _size;
+    unsigned nGroups;
+
+    //Hash function and key equality
+    const Hasher h;
+    const Key_Equal equal;
+
+    //Number of items stored in the table
+    unsigned nItems;
+
+    //Number of slots that are marked as deleted
+    unsigned nDeleted;
+
+    //Control bytes, one per slot
+    int8_t* ctrl;
+
+    //Slots, in the same order as the control bytes
+    Slot* slots;
+
+    //Some statistics
+    unsigned total_visited_slots;  //total number of visited slots
+    unsigned count_new_items;      //number of Items created
+
+
+    /* ********************************** *
+    * Auxiliar member functions           *
+    * *********************************** */
+
+    //Disable copy constructor!!
+    SwissTable(const SwissTable &) = delete;
+
+    //Disable assignment operator!!
+    const SwissTable& operator=(const SwissTable &) = delete;
+
+    //Item stored in slot i, the slot must be full
+    Item_Type& item(unsigned i)
+    {
+        return *launder(reinterpret_cast<Item_Type*>(slots[i].storage));
+    }
+
+    const Item_Type& item(unsigned i) const
+    {
+        return *launder(reinterpret_cast<const Item_Type*>(slots[i].storage));
+    }
+
+    //h(key) multiplied by 2^64 / golden ratio, and the high half folded into the low half,
+    //so that the fingerprint (bits 0-6) and the group (bits 7 and up) depend on every bit of h(key)
+    size_t hash_of(const Key_Type& key) const
+    {
+        uint64_t x = (uint64_t)h(key) * 0x9E3779B97F4A7C15ull;
+        return (size_t)(x ^ (x >> 32));
+    }
+
+    //Returns the slot of key, or the slot where it should be placed. found tells which
+    //hash is hash_of(key), computed once by the caller. h2 is set to the fingerprint of key
+    unsigned help_find(const Key_Type& key, size_t hash, bool& found, int8_t& h2);
+
+    //First free slot in the probe sequence of hash, for keys known not to be in the table
+    unsigned find_free(size_t hash);
+
+    //Create the Item (key, v) in the free slot i, hash is hash_of(key)
+    void construct(unsigned i, size_t hash, const Key_Type& key, const Value_Type& v);
+
+    //Allocate n_groups empty groups
+    void allocate(unsigned n_groups);
+
+    void rehash();
+};
+
+
+/* ********************************** *
+* Member functions implementation     *
+* *********************************** */
+
+//Constructor to create a hash table
+//table_size is the least number of slots in the table
+//f is the hash function
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+SwissTable<Key_Type, Value_Type, Hasher, Key_Equal>::SwissTable(int table_size, const Hasher& f, const Key_Equal& eq)
+    : h(f), equal(eq), nItems(0), nDeleted(0), total_visited_slots(0), count_new_items(0)
+{
+    unsigned n = 1;
+    while (n * Swiss_Group::WIDTH < (unsigned)table_size)
+    {
+        n *= 2;
+    }
+    allocate(n);
+}
+
+
+//Destructor
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+SwissTable<Key_Type, Value_Type, Hasher, Key_Equal>::~SwissTable()
+{
+    for (unsigned i = 0; i < _size; i++) {
+        if (ctrl[i] >= 0) {
+            item(i).~Item_Type();
+        }
+    }
+    delete[] ctrl;
+    delete[] slots;
+}
+
+
+//Return a pointer to the value associated with key
+//If key does not exist in the table then nullptr is returned
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+const Value_Type* SwissTable<Key_Type, Value_Type, Hasher, Key_Equal>::_find(const Key_Type& key)
+{
+    bool found;
+    int8_t h2;
+    size_t hash = hash_of(key);
+    auto i = help_find(key, hash, found, h2);
+
+    if (found) {
+        return &item(i).get_value();
+    }
+    // key not found
+    return nullptr;
+}
+
+
+//Insert the Item (key, v) in the table
+//If key already exists in the table then change the value associated with key to v
+//Re-hash if the table reaches the SWISS_MAX_LOAD_FACTOR
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+void SwissTable<Key_Type, Value_Type, Hasher, Key_Equal>::_insert(const Key_Type& key, const Value_Type& v)
+{
+    bool found;
+    int8_t h2;
+    size_t hash = hash_of(key);
+    auto i = help_find(key, hash, found, h2);
+
+    if (!found) {
+        construct(i, hash, key, v);
+    } else {
+        // key was already in there, update the value.
+        item(i).get_value() = v;
+    }
+
+    if (loadFactor() >= SWISS_MAX_LOAD_FACTOR) {
+        rehash();
+    }
+}
+
+
+//Remove Item with key, if the item exists
+//If an Item was removed then return true
+//otherwise, return false
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+bool SwissTable<Key_Type, Value_Type, Hasher, Key_Equal>::_remove(const Key_Type& key)
+{
+    bool found;
+    int8_t h2;
+    size_t hash = hash_of(key);
+    auto i = help_find(key, hash, found, h2);
+
+    if (!found) {
+        // No value was deleted
+        return false;
+    }
+
+    item(i).~Item_Type();
+    nItems--;
+
+    // Searches stop at a group with an EMPTY slot, so no search has probed past this group
+    // and the slot can be EMPTY again. Otherwise it is marked as deleted
+    const int8_t* group = ctrl + (i / Swiss_Group::WIDTH) * Swiss_Group::WIDTH;
+    if (Swiss_Group::match_empty(group)) {
+        ctrl[i] = Swiss_Group::EMPTY;
+    } else {
+        ctrl[i] = Swiss_Group::DELETED;
+        nDeleted++;
+    }
+    return true;
+}
+
+
+// Return reference to the value of the object that has the supplied key..
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+Value_Type& SwissTable<Key_Type, Value_Type, Hasher, Key_Equal>::operator[](const Key_Type& key)
+{
+    bool found;
+    int8_t h2;
+    size_t hash = hash_of(key);
+    auto i = help_find(key, hash, found, h2);
+
+    if (!found) {
+        // Key not found, insert new default value
+        construct(i, hash, key, Value_Type());
+
+        if (loadFactor() >= SWISS_MAX_LOAD_FACTOR) {
+            rehash();
+
+            // Will always find key because we just inserted it.
+            return item(help_find(key, hash, found, h2)).get_value();
+        }
+    }
+
+    return item(i).get_value();
+}
+
+
+//Display the table for debug and testing purposes
+//Thus, empty and deleted entries are also displayed
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+void SwissTable<Key_Type, Value_Type, Hasher, Key_Equal>::display(ostream& os)
+{
+    os << "-------------------------------\n";
+    os << "Number of items in the table: " << get_number_OF_items() << endl;
+    os << "Load factor: " << fixed << setprecision(2) << loadFactor() << endl;
+
+    for (unsigned i = 0; i < _size; ++i)
+    {
+        os << setw(6) << i << ": ";
+
+        if (ctrl[i] == Swiss_Group::EMPTY)
+        {
+            os << "null" << endl;
+        }
+        else if (ctrl[i] == Swiss_Group::DELETED)
+        {
+            os << "deleted" << endl;
+        }
+        else
+        {
+            size_t hash = slots[i].hash;
+            os << item(i)
+               << "  (group " << ((hash >> 7) & (nGroups - 1)) << ", fingerprint " << (int)ctrl[i] << ")" << endl;
+        }
+    }
+
+    os << endl;
+}
+
+
+/* ********************************** *
+* Auxiliar member functions           *
+* *********************************** */
+
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+unsigned SwissTable<Key_Type, Value_Type, Hasher, Key_Equal>::help_find(const Key_Type& key, size_t hash, bool& found, int8_t& h2)
+{
+    unsigned mask = nGroups - 1;
+    unsigned g = (hash >> 7) & mask;
+    unsigned free_slot = _size;
+
+    h2 = (int8_t)(hash & 0x7F);
+    found = false;
+
+    for (unsigned step = 1; ; ++step) {
+        const int8_t* group = ctrl + g * Swiss_Group::WIDTH;
+        total_visited_slots++;
+
+        // Compare the keys of the slots with a matching fingerprint
+        for (uint32_t bits = Swiss_Group::match(group, h2); bits; bits &= bits - 1) {
+            unsigned i = g * Swiss_Group::WIDTH + __builtin_ctz(bits);
+            total_visited_slots++;
+            if (slots[i].hash == hash && equal(item(i).get_key(), key)) {
+                found = true;
+                return i;
+            }
+        }
+
+        // A new key goes in the first free slot of the probe sequence, deleted slots are reused
+        if (free_slot == _size) {
+            uint32_t free_bits = Swiss_Group::match_free(group);
+            if (free_bits) {
+                free_slot = g * Swiss_Group::WIDTH + __builtin_ctz(free_bits);
+            }
+        }
+
+        // key would have been placed in an EMPTY slot of this group
+        // We are guaranteed to always find one because the table will rehash before it is full
+        if (Swiss_Group::match_empty(group)) {
+            return free_slot;
+        }
+
+        g = (g + step) & mask;
+    }
+}
+
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+unsigned SwissTable<Key_Type, Value_Type, Hasher, Key_Equal>::find_free(size_t hash)
+{
+    unsigned mask = nGroups - 1;
+    unsigned g = (hash >> 7) & mask;
+
+    for (unsigned step = 1; ; ++step) {
+        total_visited_slots++;
+        uint32_t free_bits = Swiss_Group::match_free(ctrl + g * Swiss_Group::WIDTH);
+        if (free_bits) {
+            return g * Swiss_Group::WIDTH + __builtin_ctz(free_bits);
+        }
+        g = (g + step) & mask;
+    }
+}
+
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+void SwissTable<Key_Type, Value_Type, Hasher, Key_Equal>::construct(unsigned i, size_t hash, const Key_Type& key, const Value_Type& v)
+{
+    if (ctrl[i] == Swiss_Group::DELETED) {
+        nDeleted--;
+    }
+    new (slots[i].storage) Item_Type(key, v);
+    slots[i].hash = hash;
+    ctrl[i] = (int8_t)(hash & 0x7F);
+    count_new_items++;
+    nItems++;
+}
+
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+void SwissTable<Key_Type, Value_Type, Hasher, Key_Equal>::allocate(unsigned n_groups)
+{
+    nGroups = n_groups;
+    _size = n_groups * Swiss_Group::WIDTH;
+    ctrl = new int8_t[_size];
+    memset(ctrl, Swiss_Group::EMPTY, _size);
+    slots = new Slot[_size];
+}
+
+//The table doubles when most of the load is items, otherwise it is rebuilt
+//with the same size to drop the deleted slots
+template <typename Key_Type, typename Value_Type, typename Hasher, typename Key_Equal>
+void SwissTable<Key_Type, Value_Type, Hasher, Key_Equal>::rehash()
+{
+    auto old_ctrl = ctrl;
+    auto old_slots = slots;
+    auto old_size = _size;
+
+    allocate(nItems >= old_size / 2 ? 2 * nGroups : nGroups);
+    nDeleted = 0;
+
+    // Move elements over to the new arrays, with the hashes stored in the old slots
+    // The keys are known to be distinct, so they are not compared
+    for (unsigned i = 0; i < old_size; i++) {
+        if (old_ctrl[i] >= 0) {
+            Item_Type* old_item = launder(reinterpret_cast<Item_Type*>(old_slots[i].storage));
+            unsigned j = find_free(old_slots[i].hash);
+
+            new (slots[j].storage) Item_Type(std::move(*old_item));
+            slots[j].hash = old_slots[i].hash;
+            ctrl[j] = old_ctrl[i];
+            old_item->~Item_Type();
+        }
+    }
+
+    delete[] old_ctrl;
+    delete[] old_slots;
+}
+
+#endif // SWISS_TABLE_H
@@ -14,7 +14,11 @@
 using namespace std;
 
 
-unsigned my_hash(string s, int tableSize);
+//Sum of the characters, many words collide
+struct My_Hash
+{
+    size_t operator()(const string& s) const;
+};
 
 int menu();
 
@@ -24,7 +28,7 @@ int main()
 {
     const int TABLE_SIZE = 7;
 
-    HashTable<string,int> table(TABLE_SIZE, my_hash);
+    HashTable<string,int,My_Hash> table(TABLE_SIZE);
 
     string key;
     const int* p_value = nullptr;
@@ -92,15 +96,13 @@ int main()
 }
 
 
-unsigned my_hash(string s, int tableSize)
+size_t My_Hash::operator()(const string& s) const
 {
     unsigned hashVal = 0;
 
     for(unsigned i = 0; i < s.length(); i++)
         hashVal += s[i];
 
-    hashVal %= tableSize;
-
     return hashVal;
 }
 
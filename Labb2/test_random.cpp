@@ -0,0 +1,155 @@
+/*
+  Course: TND004, Lab 2
+  Description: randomized test program for HashTable and SwissTable with string keys
+  Random inserts, removes, lookups and operator[] are done on the table and on a std::map,
+  in waves that fill the table and empty it again, so that HashTable shifts items back on removal,
+  SwissTable reuses the tombstones of removed items, and both tables are rehashed many times.
+  Every result is compared with the std::map
+  Returns 1 if a test fails
+*/
+
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <map>
+#include <random>
+
+#include "hashTable.h"
+#include "swissTable.h"
+
+using namespace std;
+
+const int OPERATIONS = 200000;
+const int KEYS = 3000;
+
+//Length of a wave of mostly inserts or mostly removes
+const int WAVE = 20000;
+
+int failed = 0;
+
+void expect(bool ok, const string& what)
+{
+    if (!ok)
+    {
+        cout << "FAILED: " << what << endl;
+        failed++;
+    }
+}
+
+//Only 1024 different hashes, spread over the table. About three keys share each full hash
+struct Narrow_Hash
+{
+    size_t operator()(const string& s) const
+    {
+        size_t v = 0;
+        for (char c : s) v = 37 * v + c;
+        return v % 1024 * 2654435761u;
+    }
+};
+
+//Polynomial hash, few collisions
+struct Poly_Hash
+{
+    size_t operator()(const string& s) const
+    {
+        size_t v = 0;
+        for (char c : s) v = 37 * v + c;
+        return v;
+    }
+};
+
+template <template <class, class, class, class> class Table, typename Hasher>
+void check_random(const string& name, unsigned seed)
+{
+    //HashTable reports every rehash on cout
+    ostringstream quiet;
+    streambuf* old = cout.rdbuf(quiet.rdbuf());
+
+    //A small table, it is rehashed many times
+    Table<string, int, Hasher, equal_to<string>> table(7);
+    map<string, int> M;
+    mt19937 rand(seed);
+
+    bool inserted = true, removed = true, found = true, subscript = true;
+
+    for (int i = 0; i < OPERATIONS; ++i)
+    {
+        string key = to_string(rand() % KEYS);
+
+        //Even waves mostly insert, odd waves mostly remove
+        unsigned op = rand() % 8;
+        bool removing = (i / WAVE) % 2 == 1;
+
+        if (op < (removing ? 5u : 1u))
+        {
+            removed = removed && table._remove(key) == (M.erase(key) == 1);
+        }
+        else if (op < 6)
+        {
+            table._insert(key, i);
+            M[key] = i;
+
+            const int* v = table._find(key);
+            inserted = inserted && v && *v == i;
+        }
+        else if (op < 7)
+        {
+            subscript = subscript && ++table[key] == ++M[key];
+        }
+        else
+        {
+            const int* v = table._find(key);
+            auto it = M.find(key);
+            found = found && (v != nullptr) == (it != M.end()) && (!v || *v == it->second);
+        }
+    }
+
+    bool all = table.get_number_OF_items() == M.size();
+    for (const auto& p : M)
+    {
+        const int* v = table._find(p.first);
+        all = all && v && *v == p.second;
+    }
+
+    cout.rdbuf(old);
+
+    string what = name + ", seed " + to_string(seed);
+    expect(inserted, what + ": an inserted key is found with its value");
+    expect(removed, what + ": _remove finds the keys that are in the table");
+    expect(found, what + ": _find");
+    expect(subscript, what + ": operator[]");
+    expect(all, what + ": every key left is found, number of items");
+}
+
+int main()
+{
+    /*****************************************************
+    * TEST PHASE 1                                       *
+    * HashTable                                          *
+    ******************************************************/
+    cout << "TEST PHASE 1: HashTable\n";
+
+    for (unsigned seed = 1; seed <= 3; ++seed)
+    {
+        check_random<HashTable, Narrow_Hash>("HashTable, 1024 hashes", seed);
+        check_random<HashTable, Poly_Hash>("HashTable, polynomial hash", seed);
+        check_random<HashTable, hash<string>>("HashTable, std::hash", seed);
+    }
+
+    /*****************************************************
+    * TEST PHASE 2                                       *
+    * SwissTable                                         *
+    ******************************************************/
+    cout << "\nTEST PHASE 2: SwissTable\n";
+
+    for (unsigned seed = 1; seed <= 3; ++seed)
+    {
+        check_random<SwissTable, Narrow_Hash>("SwissTable, 1024 hashes", seed);
+        check_random<SwissTable, Poly_Hash>("SwissTable, polynomial hash", seed);
+        check_random<SwissTable, hash<string>>("SwissTable, std::hash", seed);
+    }
+
+    cout << (failed ? "\nSome tests FAILED" : "\nAll tests PASSED") << endl;
+
+    return failed ? 1 : 0;
+}
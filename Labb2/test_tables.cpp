@@ -0,0 +1,117 @@
+/*
+  Course: TND004, Lab 2
+  Description: test program for HashTable and SwissTable with integer keys and the default hasher
+  std::hash of an integer is the integer itself, so sequential and strided keys show
+  how well the tables spread keys whose hashes differ only in a few bits
+  Returns 1 if a test fails
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <sstream>
+
+#include "hashTable.h"
+#include "swissTable.h"
+
+using namespace std;
+
+const int N = 50000;
+
+//Most slots visited per lookup, on average
+const double MAX_VISITED = 3.0;
+
+int failed = 0;
+
+void expect(bool ok, const string& what)
+{
+    if (!ok)
+    {
+        cout << "FAILED: " << what << endl;
+        failed++;
+    }
+}
+
+//Insert the keys 0, stride, 2 * stride, ..., look all of them up, remove every second one
+template <template <class, class, class, class> class Table>
+void check_keys(const string& name, int stride)
+{
+    string what = name + ", stride " + to_string(stride);
+
+    //HashTable reports every rehash on cout
+    ostringstream quiet;
+    streambuf* old = cout.rdbuf(quiet.rdbuf());
+
+    Table<int, int, hash<int>, equal_to<int>> table(16);
+
+    for (int i = 0; i < N; ++i)
+    {
+        table[i * stride] = i;
+    }
+
+    unsigned before = table.get_total_visited_slots();
+    bool all_found = true;
+    for (int i = 0; i < N; ++i)
+    {
+        const int* v = table._find(i * stride);
+        all_found = all_found && v && *v == i;
+    }
+    double visited = (double)(table.get_total_visited_slots() - before) / N;
+
+    bool none_found = true;
+    for (int i = 0; i < N; ++i)
+    {
+        none_found = none_found && !table._find(i * stride + (stride > 1 ? 1 : N));
+    }
+
+    for (int i = 0; i < N; i += 2)
+    {
+        table._remove(i * stride);
+    }
+
+    bool removed = true;
+    for (int i = 0; i < N; ++i)
+    {
+        const int* v = table._find(i * stride);
+        removed = removed && (i % 2 == 0 ? !v : v && *v == i);
+    }
+
+    cout.rdbuf(old);
+
+    cout << setw(12) << name << ", stride " << setw(5) << stride << ": "
+         << fixed << setprecision(2) << visited << " slots visited per lookup" << endl;
+
+    expect(all_found, what + ": every key is found");
+    expect(none_found, what + ": keys not inserted are not found");
+    expect(removed, what + ": removed keys are gone, the others are left");
+    expect(table.get_number_OF_items() == (unsigned)N / 2, what + ": number of items");
+    expect(visited <= MAX_VISITED, what + ": slots visited per lookup");
+}
+
+int main()
+{
+    /*****************************************************
+    * TEST PHASE 1                                       *
+    * Sequential keys                                    *
+    ******************************************************/
+    cout << "TEST PHASE 1: sequential keys\n";
+
+    check_keys<HashTable>("HashTable", 1);
+    check_keys<SwissTable>("SwissTable", 1);
+
+    /*****************************************************
+    * TEST PHASE 2                                       *
+    * Keys that differ only in their high bits           *
+    ******************************************************/
+    cout << "\nTEST PHASE 2: strided keys\n";
+
+    for (int stride : { 128, 1024, 4096 })
+    {
+        check_keys<HashTable>("HashTable", stride);
+        check_keys<SwissTable>("SwissTable", stride);
+    }
+
+    cout << (failed ? "\nSome tests FAILED" : "\nAll tests PASSED") << endl;
+
+    return failed ? 1 : 0;
+}